@@ -0,0 +1,146 @@
+#include "agent_store.h"
+
+template <typename F>
+void agent_store::for_each_column(F&& fn) {
+    fn(posX); fn(posY);
+    fn(velX); fn(velY);
+    fn(forceX); fn(forceY);
+    fn(rotation);
+    fn(prevX); fn(prevY);
+    fn(prevRotation);
+    fn(targetX); fn(targetY);
+    fn(futureX); fn(futureY);
+    fn(desiredX); fn(desiredY);
+    fn(wanderAngle);
+    fn(wanderTimer);
+    fn(pathProgress);
+}
+
+agent_handle agent_store::add(const vec2& position, const vec2& target, f32 wanderAngle, b2Body* body) {
+    u32 slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else if (sparse.size() < (size_t)MAX_AGENTS) {
+        slot = (u32)sparse.size();
+        sparse.push_back(-1);
+        generations.push_back(0);
+    }
+    else {
+        return INVALID_AGENT;
+    }
+
+    agent_handle handle = (generations[slot] << AGENT_SLOT_BITS) | slot;
+    sparse[slot] = size();
+    handles.push_back(handle);
+
+    posX.push_back(position.x);
+    posY.push_back(position.y);
+    velX.push_back(0.f);
+    velY.push_back(0.f);
+    forceX.push_back(0.f);
+    forceY.push_back(0.f);
+    rotation.push_back(0.f);
+    prevX.push_back(position.x);
+    prevY.push_back(position.y);
+    prevRotation.push_back(0.f);
+
+    targetX.push_back(target.x);
+    targetY.push_back(target.y);
+    futureX.push_back(0.f);
+    futureY.push_back(0.f);
+    desiredX.push_back(0.f);
+    desiredY.push_back(0.f);
+    this->wanderAngle.push_back(wanderAngle);
+    wanderTimer.push_back(0.f);
+    pathProgress.push_back(0.f);
+
+    bodies.push_back(body);
+    lodLevel.push_back(0);
+    pathCursor.push_back(path_cursor());
+    route.push_back(nullptr);
+    routePlan.push_back(nullptr);
+    routeLeg.push_back(0);
+    routeTicket.push_back(0);
+    routeEpoch.push_back(0);
+
+    return handle;
+}
+
+void agent_store::remove(agent_handle handle) {
+    int index = index_of(handle);
+    if (index < 0) {
+        return;
+    }
+
+    int last = size() - 1;
+    if (index != last) {
+        for_each_column([index, last](column<f32>& c) {
+            c[index] = c[last];
+        });
+        bodies[index] = bodies[last];
+        lodLevel[index] = lodLevel[last];
+        pathCursor[index] = pathCursor[last];
+        route[index] = std::move(route[last]);
+        routePlan[index] = std::move(routePlan[last]);
+        routeLeg[index] = routeLeg[last];
+        routeTicket[index] = routeTicket[last];
+        routeEpoch[index] = routeEpoch[last];
+        handles[index] = handles[last];
+        sparse[handles[index] & AGENT_SLOT_MASK] = index;
+    }
+
+    for_each_column([](column<f32>& c) {
+        c.pop_back();
+    });
+    bodies.pop_back();
+    lodLevel.pop_back();
+    pathCursor.pop_back();
+    route.pop_back();
+    routePlan.pop_back();
+    routeLeg.pop_back();
+    routeTicket.pop_back();
+    routeEpoch.pop_back();
+    handles.pop_back();
+
+    u32 slot = handle & AGENT_SLOT_MASK;
+    sparse[slot] = -1;
+    generations[slot] = (generations[slot] + 1) & (0xffffffffu >> AGENT_SLOT_BITS);
+    freeSlots.push_back(slot);
+}
+
+void agent_store::clear() {
+    for_each_column([](column<f32>& c) {
+        c.clear();
+    });
+    bodies.clear();
+    lodLevel.clear();
+    pathCursor.clear();
+    route.clear();
+    routePlan.clear();
+    routeLeg.clear();
+    routeTicket.clear();
+    routeEpoch.clear();
+    handles.clear();
+    sparse.clear();
+    generations.clear();
+    freeSlots.clear();
+}
+
+void agent_store::reserve(int count) {
+    for_each_column([count](column<f32>& c) {
+        c.reserve(count);
+    });
+    bodies.reserve(count);
+    lodLevel.reserve(count);
+    pathCursor.reserve(count);
+    route.reserve(count);
+    routePlan.reserve(count);
+    routeLeg.reserve(count);
+    routeTicket.reserve(count);
+    routeEpoch.reserve(count);
+    handles.reserve(count);
+    sparse.reserve(count);
+    generations.reserve(count);
+}
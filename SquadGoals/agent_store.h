@@ -0,0 +1,158 @@
+#pragma once
+
+#include "algebra.h"
+#include "path.h"
+
+#include <vector>
+#include <memory>
+#include <cstdlib>
+#include <new>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+// structure of arrays agent storage
+// every field is its own contiguous column so a pass only pulls in the cache lines it touches,
+// columns are 32 byte aligned so they can be streamed with aligned sse/avx loads.
+// dense indices shift on remove, handles stay put. a handle is a slot plus a generation that
+// bumps every time the slot is freed, so handles held past a remove go stale instead of aliasing
+// whichever agent reuses the slot.
+
+class b2Body;
+struct hpa_plan;
+
+template <typename T>
+struct simd_allocator {
+    typedef T value_type;
+
+    static const size_t ALIGNMENT = 32;
+
+    simd_allocator() = default;
+    template <typename U>
+    simd_allocator(const simd_allocator<U>&) { }
+
+    T* allocate(size_t n) {
+#ifdef _MSC_VER
+        void* p = _aligned_malloc(n * sizeof(T), ALIGNMENT);
+#else
+        void* p = nullptr;
+        if (posix_memalign(&p, ALIGNMENT, n * sizeof(T)) != 0) {
+            p = nullptr;
+        }
+#endif
+        if (p == nullptr) {
+            throw std::bad_alloc();
+        }
+        return (T*)p;
+    }
+
+    void deallocate(T* p, size_t) {
+#ifdef _MSC_VER
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+};
+
+template <typename T, typename U>
+inline bool operator==(const simd_allocator<T>&, const simd_allocator<U>&) { return true; }
+
+template <typename T, typename U>
+inline bool operator!=(const simd_allocator<T>&, const simd_allocator<U>&) { return false; }
+
+template <typename T>
+using column = std::vector<T, simd_allocator<T>>;
+
+typedef u32 agent_handle;
+const agent_handle INVALID_AGENT = 0xffffffff;
+
+// low bits pick the slot, high bits are the generation
+const u32 AGENT_SLOT_BITS = 20;
+const u32 AGENT_SLOT_MASK = (1u << AGENT_SLOT_BITS) - 1;
+// the all ones slot is never handed out so INVALID_AGENT cant be a live handle
+const int MAX_AGENTS = (int)AGENT_SLOT_MASK;
+
+class agent_store {
+public:
+    // INVALID_AGENT once MAX_AGENTS are alive
+    agent_handle add(const vec2& position, const vec2& target, f32 wanderAngle, b2Body* body);
+    // swaps the last agent into the removed slot
+    void remove(agent_handle handle);
+    void clear();
+    void reserve(int count);
+
+    inline int size() const { return (int)handles.size(); }
+
+    // -1 if the handle no longer refers to an agent
+    inline int index_of(agent_handle handle) const {
+        u32 slot = handle & AGENT_SLOT_MASK;
+        if (slot >= sparse.size() || generations[slot] != (handle >> AGENT_SLOT_BITS)) {
+            return -1;
+        }
+        return sparse[slot];
+    }
+    inline bool alive(agent_handle handle) const { return index_of(handle) >= 0; }
+    inline agent_handle handle_at(int index) const { return handles[index]; }
+
+    inline vec2 position(int i) const { return vec2(posX[i], posY[i]); }
+    inline vec2 velocity(int i) const { return vec2(velX[i], velY[i]); }
+    inline vec2 force(int i) const { return vec2(forceX[i], forceY[i]); }
+    inline vec2 target(int i) const { return vec2(targetX[i], targetY[i]); }
+    inline vec2 future(int i) const { return vec2(futureX[i], futureY[i]); }
+
+    // blends from the previous tick's state to the latest, alpha in [0, 1]
+    inline vec2 interpolated_position(int i, f32 alpha) const {
+        return vec2(math::lerp(prevX[i], posX[i], alpha), math::lerp(prevY[i], posY[i], alpha));
+    }
+    inline f32 interpolated_rotation(int i, f32 alpha) const {
+        return math::lerp_angle(prevRotation[i], rotation[i], alpha);
+    }
+
+    // hot, read or written by every pass
+    column<f32> posX, posY;
+    column<f32> velX, velY;
+    column<f32> forceX, forceY;
+    column<f32> rotation;
+
+    // last tick's state, only read for render interpolation
+    column<f32> prevX, prevY;
+    column<f32> prevRotation;
+
+    // cold, only touched by target selection and debug drawing
+    column<f32> targetX, targetY;
+    column<f32> futureX, futureY;
+    // velocity the last full steer aimed for, lod skipped ticks re-aim the force at it
+    column<f32> desiredX, desiredY;
+    column<f32> wanderAngle;
+    column<f32> wanderTimer;
+    // arc length along the shared path at the last projection
+    column<f32> pathProgress;
+
+    std::vector<b2Body*> bodies;
+
+    // steering level of detail bucket, 0 updates every tick
+    std::vector<u8> lodLevel;
+    // where each agent last found itself on the shared path, or on its route in route mode
+    std::vector<path_cursor> pathCursor;
+    // planned way to the goal, shared with every agent that asked from the same cell. with
+    // hierarchical routes it only covers the leg of the plan the agent is on
+    std::vector<std::shared_ptr<const path>> route;
+    std::vector<std::shared_ptr<hpa_plan>> routePlan;
+    std::vector<int> routeLeg;
+    // outstanding route request, 0 when none. agents keep their old route until it lands
+    std::vector<u32> routeTicket;
+    // the sim's route epoch when the route was planned, behind it means goal or grid moved since
+    std::vector<u32> routeEpoch;
+
+private:
+    template <typename F>
+    void for_each_column(F&& fn);
+
+    // dense index -> handle and slot -> dense index
+    std::vector<agent_handle> handles;
+    std::vector<int> sparse;
+    std::vector<u32> generations;
+    std::vector<u32> freeSlots;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "types.h"
+
+// stateless counter based random numbers
+// a generator is just a key hashed from (seed, stream, tick) plus a draw counter, every draw is
+// splitmix64 of key + counter. any thread can rebuild any agent's numbers for any tick without
+// shared state, so results dont depend on which thread evaluates an agent or in what order.
+
+class counter_rng {
+public:
+    counter_rng(u64 seed, u64 stream, u64 tick)
+        : key(mix(mix(mix(seed) ^ stream) ^ tick)), counter(0) { }
+
+    inline u32 next_u32() {
+        return (u32)(mix(key + ++counter * GOLDEN) >> 32);
+    }
+
+    // [0, 1)
+    inline f32 next_f32() {
+        return (f32)(next_u32() >> 8) * (1.f / 16777216.f);
+    }
+
+    // [lo, hi)
+    inline f32 range(f32 lo, f32 hi) {
+        return lo + (hi - lo) * next_f32();
+    }
+
+    // [lo, hi]
+    inline int range_int(int lo, int hi) {
+        return lo + (int)(((u64)next_u32() * (u64)(hi - lo + 1)) >> 32);
+    }
+
+    // splitmix64 finalizer
+    static inline u64 mix(u64 z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    static const u64 GOLDEN = 0x9e3779b97f4a7c15ull;
+
+    u64 key;
+    u64 counter;
+};
@@ -0,0 +1,45 @@
+#include "cpu_features.h"
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+struct cpu_features {
+    bool sse41 = false;
+    bool avx2 = false;
+};
+
+static cpu_features detect() {
+    cpu_features found;
+#if defined(SIMD_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+    found.sse41 = (info[2] & (1 << 19)) != 0;
+    // avx state has to be enabled by the os as well as supported by the cpu
+    const bool osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    if (osAvx && maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        found.avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#elif defined(SIMD_X86)
+    __builtin_cpu_init();
+    found.sse41 = __builtin_cpu_supports("sse4.1") != 0;
+    found.avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+    return found;
+}
+
+static const cpu_features& features() {
+    static const cpu_features detected = detect();
+    return detected;
+}
+
+bool cpu_has_sse41() {
+    return features().sse41;
+}
+
+bool cpu_has_avx2() {
+    return features().avx2;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// optional instruction sets, checked against the running cpu once. kernels that need one are
+// compiled with SIMD_TARGET so they build without the project's arch flags and only run when
+// the cpu check passes
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+bool cpu_has_sse41();
+bool cpu_has_avx2();
@@ -0,0 +1,235 @@
+#include "dstar_lite.h"
+#include "path_builder.h"
+
+#include <algorithm>
+#include <limits>
+
+static const i64 UNREACHABLE = std::numeric_limits<i64>::max();
+
+const dstar_lite::fixed_cost dstar_lite::UNIT;
+
+dstar_lite::dstar_lite(const nav_grid& grid)
+    : grid(grid)
+{
+    const int cells = grid.layout().cell_count();
+    g.assign(cells, UNREACHABLE);
+    rhs.assign(cells, UNREACHABLE);
+    for (int k = 0; k < GRID_STEP_COUNT; ++k) {
+        stepCost[k] = (fixed_cost)(GRID_STEPS[k].length * (f32)UNIT + 0.5f);
+    }
+}
+
+dstar_lite::fixed_cost dstar_lite::heuristic(int from, int to) const {
+    // octile in the same fixed point steps the search walks, so it never overestimates one of them
+    const int w = grid.width();
+    int dx = from % w - to % w;
+    int dy = from / w - to / w;
+    dx = (dx < 0) ? -dx : dx;
+    dy = (dy < 0) ? -dy : dy;
+    const int diag = (dx < dy) ? dx : dy;
+    const int straight = ((dx > dy) ? dx : dy) - diag;
+    return stepCost[0] * straight + stepCost[4] * diag;
+}
+
+dstar_lite::search_key dstar_lite::key_of(int cell) const {
+    const fixed_cost m = (g[cell] < rhs[cell]) ? g[cell] : rhs[cell];
+    if (m == UNREACHABLE) {
+        return { UNREACHABLE, UNREACHABLE };
+    }
+    return { m + heuristic(startCell, cell) + keyOffset, m };
+}
+
+void dstar_lite::push(int cell, const search_key& key) {
+    open.push_back({ key, cell });
+    std::push_heap(open.begin(), open.end(), [](const open_node& a, const open_node& b) {
+        return before(b.key, a.key);
+    });
+}
+
+dstar_lite::fixed_cost dstar_lite::lookahead(int cell) const {
+    if (grid.cost(cell) == nav_grid::BLOCKED) {
+        return UNREACHABLE;
+    }
+    if (cell == goalCell) {
+        return 0;
+    }
+
+    const int w = grid.width();
+    const int cx = cell % w;
+    const int cy = cell / w;
+    fixed_cost best = UNREACHABLE;
+    for (int k = 0; k < GRID_STEP_COUNT; ++k) {
+        if (!grid.can_step(cx, cy, k)) {
+            continue;
+        }
+
+        const int next = (cy + GRID_STEPS[k].dy) * w + cx + GRID_STEPS[k].dx;
+        if (g[next] != UNREACHABLE) {
+            const fixed_cost c = g[next] + stepCost[k] * grid.cost(next);
+            best = (c < best) ? c : best;
+        }
+    }
+    return best;
+}
+
+void dstar_lite::update_cell(int cell) {
+    rhs[cell] = lookahead(cell);
+    if (g[cell] != rhs[cell]) {
+        push(cell, key_of(cell));
+    }
+}
+
+void dstar_lite::reset() {
+    std::fill(g.begin(), g.end(), UNREACHABLE);
+    std::fill(rhs.begin(), rhs.end(), UNREACHABLE);
+    open.clear();
+    keyOffset = 0;
+    lastStart = startCell;
+    update_cell(goalCell);
+}
+
+std::shared_ptr<const path> dstar_lite::plan(const vec2& start, const vec2& goal) {
+    const grid_layout& layout = grid.layout();
+    int sx, sy, gx, gy;
+    if (!layout.world_to_cell(start, sx, sy) || !layout.world_to_cell(goal, gx, gy)) {
+        return nullptr;
+    }
+
+    const int goalAt = layout.index(gx, gy);
+    startCell = layout.index(sx, sy);
+    expanded = 0;
+
+    const int* changed = nullptr;
+    int changedCount = 0;
+    lastRepair = (goalAt == goalCell && grid.changes_since(solvedVersion, changed, changedCount));
+    goalCell = goalAt;
+    solvedVersion = grid.version();
+
+    if (lastRepair) {
+        // queued keys were measured from the old start, rather than re-keying the whole queue
+        // every later key is lifted by how far the start moved, which keeps the order intact
+        keyOffset += heuristic(lastStart, startCell);
+        lastStart = startCell;
+
+        const int w = grid.width();
+        for (int c = 0; c < changedCount; ++c) {
+            const int cx = changed[c] % w;
+            const int cy = changed[c] / w;
+            for (int y = cy - 1; y <= cy + 1; ++y) {
+                for (int x = cx - 1; x <= cx + 1; ++x) {
+                    if (layout.contains(x, y)) {
+                        update_cell(y * w + x);
+                    }
+                }
+            }
+        }
+        ++repairs;
+    }
+    else {
+        reset();
+        ++solves;
+    }
+
+    compute();
+    if (!lastRepair) {
+        fullExpanded = expanded;
+    }
+    return extract();
+}
+
+void dstar_lite::compute() {
+    auto later = [](const open_node& a, const open_node& b) {
+        return before(b.key, a.key);
+    };
+
+    const grid_layout& layout = grid.layout();
+    const int w = grid.width();
+
+    // stops once the start is settled and nothing queued could still improve it
+    while (!open.empty() && (before(open.front().key, key_of(startCell)) || g[startCell] != rhs[startCell])) {
+        std::pop_heap(open.begin(), open.end(), later);
+        const open_node node = open.back();
+        open.pop_back();
+
+        const int cell = node.cell;
+        if (g[cell] == rhs[cell]) {
+            continue;
+        }
+
+        // keys only grow as the start moves, an old one gets re-queued at its real priority, and
+        // one above the real key has a fresher entry that already ran
+        const search_key key = key_of(cell);
+        if (before(node.key, key)) {
+            push(cell, key);
+            continue;
+        }
+        if (before(key, node.key)) {
+            continue;
+        }
+        ++expanded;
+
+        if (g[cell] > rhs[cell]) {
+            g[cell] = rhs[cell];
+        }
+        else {
+            g[cell] = UNREACHABLE;
+            update_cell(cell);
+        }
+
+        const int cx = cell % w;
+        const int cy = cell / w;
+        for (int k = 0; k < GRID_STEP_COUNT; ++k) {
+            const int nx = cx + GRID_STEPS[k].dx;
+            const int ny = cy + GRID_STEPS[k].dy;
+            if (layout.contains(nx, ny)) {
+                update_cell(ny * w + nx);
+            }
+        }
+    }
+}
+
+std::shared_ptr<const path> dstar_lite::extract() const {
+    if (g[startCell] == UNREACHABLE && startCell != goalCell) {
+        return nullptr;
+    }
+    if (grid.cost(startCell) == nav_grid::BLOCKED || grid.cost(goalCell) == nav_grid::BLOCKED) {
+        return nullptr;
+    }
+
+    const grid_layout& layout = grid.layout();
+    const int w = grid.width();
+
+    // downhill from the start, every cell on the way is a vertex and the builder folds straight runs.
+    // only settled cells are trusted, and g drops with every step, so a walk that cant go on or
+    // would come back round fails here instead of wandering
+    path_builder builder;
+    int cell = startCell;
+    builder.add(layout.cell_middle(cell % w, cell / w));
+    while (cell != goalCell) {
+        const int cx = cell % w;
+        const int cy = cell / w;
+        fixed_cost best = UNREACHABLE;
+        int next = -1;
+        for (int k = 0; k < GRID_STEP_COUNT; ++k) {
+            if (!grid.can_step(cx, cy, k)) {
+                continue;
+            }
+            const int n = (cy + GRID_STEPS[k].dy) * w + cx + GRID_STEPS[k].dx;
+            if (g[n] == UNREACHABLE || g[n] != rhs[n] || g[n] >= g[cell]) {
+                continue;
+            }
+            const fixed_cost c = g[n] + stepCost[k] * grid.cost(n);
+            if (c < best) {
+                best = c;
+                next = n;
+            }
+        }
+        if (next < 0) {
+            return nullptr;
+        }
+        cell = next;
+        builder.add(layout.cell_middle(cell % w, cell / w));
+    }
+
+    return std::make_shared<path>(builder.build(path_dir::kCW, false));
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "nav_grid.h"
+#include "path.h"
+
+#include <vector>
+#include <memory>
+
+// incremental single agent route planner, d* lite
+// searches backwards from the goal, so the agent walking along doesnt invalidate anything, and
+// when cells change only the part of the search they touch is re-expanded instead of planning
+// over. the search state covers the whole grid per planner, so this is for the few agents that
+// matter, the crowd shares grid_astar's cached routes.
+// not thread safe, one planner per thread.
+
+class dstar_lite {
+public:
+    // the grid must outlive the planner and keep its dimensions
+    dstar_lite(const nav_grid& grid);
+
+    // route from start to goal like grid_astar::find. a new goal plans from scratch, the same goal
+    // repairs the previous search for whatever changed on the grid and wherever the start moved to
+    std::shared_ptr<const path> plan(const vec2& start, const vec2& goal);
+
+    inline int solve_count() const { return solves; }
+    inline int repair_count() const { return repairs; }
+    // nodes expanded by the most recent plan, and by the most recent from scratch plan to compare against
+    inline int last_expanded() const { return expanded; }
+    inline int full_expanded() const { return fullExpanded; }
+    inline bool last_was_repair() const { return lastRepair; }
+
+private:
+    // costs are fixed point with UNIT per cell width. keys are sums of step costs, heuristics and
+    // the start offset, and in floats two keys that should tie can land an ulp apart and stop the
+    // search before a cell it still needed, integers tie exactly
+    typedef i64 fixed_cost;
+    static const fixed_cost UNIT = 1 << 16;
+
+    struct search_key {
+        fixed_cost primary;
+        fixed_cost secondary;
+    };
+
+    struct open_node {
+        search_key key;
+        int cell;
+    };
+
+    static inline bool before(const search_key& a, const search_key& b) {
+        return (a.primary < b.primary) || (a.primary == b.primary && a.secondary < b.secondary);
+    }
+
+    void reset();
+    search_key key_of(int cell) const;
+    void push(int cell, const search_key& key);
+    fixed_cost heuristic(int from, int to) const;
+    // cheapest step into a neighbour plus its cost to the goal
+    fixed_cost lookahead(int cell) const;
+    void update_cell(int cell);
+    void compute();
+    std::shared_ptr<const path> extract() const;
+
+    const nav_grid& grid;
+
+    // cost to the goal and its one step lookahead, the search settles cells by making them agree
+    std::vector<fixed_cost> g;
+    std::vector<fixed_cost> rhs;
+    // GRID_STEPS lengths in fixed point
+    fixed_cost stepCost[GRID_STEP_COUNT];
+    // binary min heap, stale entries are skipped or re-keyed when popped
+    std::vector<open_node> open;
+
+    int startCell = -1;
+    int goalCell = -1;
+    // where the start was when the queued keys were computed, and how far it has moved since
+    int lastStart = -1;
+    fixed_cost keyOffset = 0;
+    u32 solvedVersion = 0;
+
+    int solves = 0;
+    int repairs = 0;
+    int expanded = 0;
+    int fullExpanded = 0;
+    bool lastRepair = false;
+};
@@ -1,22 +1,40 @@
 #include "flowfield.h"
 
+grid_layout::grid_layout(f32 worldWidth, f32 worldHeight, f32 cellSize, f32 offsetX, f32 offsetY)
+    : offsetX(offsetX),
+    offsetY(offsetY),
+    cellSize(cellSize),
+    cellWidth(math::ceil_int(worldWidth / cellSize)),
+    cellHeight(math::ceil_int(worldHeight / cellSize))
+{
+}
+
 flow_field::flow_field(f32 worldWidth, f32 worldHeight, f32 cellSize, f32 offsetX, f32 offsetY)
     : worldWidth(worldWidth),
     worldHeight(worldHeight),
-    cellSize(cellSize),
-    cellWidth(math::ceil_int(worldWidth / cellSize)),
-    cellHeight(math::ceil_int(worldHeight / cellSize)),
-    offsetX(offsetX),
-    offsetY(offsetY)
+    grid(worldWidth, worldHeight, cellSize, offsetX, offsetY)
 {
-    vectors.resize(cellWidth * cellHeight);
+    vectors.resize(grid.cell_count());
+}
+
+flow_field::flow_field(const grid_layout& layout)
+    : worldWidth(layout.cellWidth * layout.cellSize),
+    worldHeight(layout.cellHeight * layout.cellSize),
+    grid(layout)
+{
+    vectors.resize(grid.cell_count());
 }
 
 void flow_field::perlin_angles(const perlin_gen& perlin, f32 scale, f32 z /* = 0.f */) {
-    for (int i = 0; i < cellWidth; ++i) {
-        for (int j = 0; j < cellHeight; ++j) {
-            f32 v = perlin.noise((f32)i / cellWidth * scale, (f32)j / cellHeight * scale, z);
-            set(i, j, math::vec2_from_angle(v * 720.f));
+    std::vector<f32> xs(grid.cellHeight), ys(grid.cellHeight), vs(grid.cellHeight);
+    for (int i = 0; i < grid.cellWidth; ++i) {
+        for (int j = 0; j < grid.cellHeight; ++j) {
+            xs[j] = (f32)i / grid.cellWidth * scale;
+            ys[j] = (f32)j / grid.cellHeight * scale;
+        }
+        perlin.noise(xs.data(), ys.data(), z, vs.data(), grid.cellHeight);
+        for (int j = 0; j < grid.cellHeight; ++j) {
+            set(i, j, math::vec2_from_angle(vs[j] * 720.f));
         }
     }
 }
@@ -26,6 +44,18 @@ vec2 flow_field::perlin_get(const perlin_gen& perlin, f32 x, f32 y, f32 z /* = 0
     return math::vec2_from_angle(v * 720.f);
 }
 
+void flow_field::perlin_get(const perlin_gen& perlin, const f32* x, const f32* y, f32 z, vec2* out, int count) {
+    const int BATCH = 64;
+    f32 vs[BATCH];
+    for (int begin = 0; begin < count; begin += BATCH) {
+        const int n = (count - begin < BATCH) ? count - begin : BATCH;
+        perlin.noise(x + begin, y + begin, z, vs, n);
+        for (int i = 0; i < n; ++i) {
+            out[begin + i] = math::vec2_from_angle(vs[i] * 720.f);
+        }
+    }
+}
+
 void flow_field::set(int cellX, int cellY, vec2 vec) {
     int i = index(cellX, cellY);
     if (i >= 0) {
@@ -52,28 +82,23 @@ vec2 flow_field::get(vec2 pos) const {
 }
 
 vec2 flow_field::cell_center(int cx, int cy) {
+    const f32 cellSize = grid.cellSize;
     return vec2(cx * cellSize + cellSize / 2 - worldWidth / 2, cy * cellSize + cellSize / 2 - worldHeight / 2);
 }
 
-int flow_field::width() const { return cellWidth; }
-int flow_field::height() const { return cellHeight; }
-f32 flow_field::cell_size() const { return cellSize; }
+int flow_field::width() const { return grid.cellWidth; }
+int flow_field::height() const { return grid.cellHeight; }
+f32 flow_field::cell_size() const { return grid.cellSize; }
 
 inline int flow_field::index(int x, int y) const {
-    if (x >= 0 && x < cellWidth && y >= 0 && y < cellHeight) {
-        return y * cellWidth + x;
-    }
-    return -1;
+    return grid.index(x, y);
 }
 
 vec2 flow_field::cell_to_world(int cx, int cy) const {
-    return vec2((f32)cx * cellSize + offsetX, (f32)cy * cellSize + offsetY);
+    return grid.cell_to_world(cx, cy);
 }
 
 bool flow_field::world_to_cell(vec2 pos, int& cx, int& cy) const {
-    cx = (int)((pos.x - offsetX) / cellSize);
-    cy = (int)((pos.y - offsetY) / cellSize);
-
     // return true if is valid index, false otherwise
-    return index(cx, cy) >= 0;
+    return grid.world_to_cell(pos, cx, cy);
 }
\ No newline at end of file
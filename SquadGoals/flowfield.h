@@ -4,15 +4,50 @@
 #include "perlin.h"
 #include <vector>
 
+// cell <-> world mapping shared by every grid laid over the world, cell (0, 0) has its corner at the offset
+struct grid_layout {
+    grid_layout() = default;
+    grid_layout(f32 worldWidth, f32 worldHeight, f32 cellSize, f32 offsetX, f32 offsetY);
+
+    f32 offsetX = 0.f;
+    f32 offsetY = 0.f;
+    f32 cellSize = 1.f;
+    int cellWidth = 0;
+    int cellHeight = 0;
+
+    inline int cell_count() const { return cellWidth * cellHeight; }
+    inline bool contains(int cx, int cy) const { return cx >= 0 && cx < cellWidth && cy >= 0 && cy < cellHeight; }
+    // -1 outside the grid
+    inline int index(int cx, int cy) const { return contains(cx, cy) ? cy * cellWidth + cx : -1; }
+
+    inline vec2 cell_to_world(int cx, int cy) const {
+        return vec2((f32)cx * cellSize + offsetX, (f32)cy * cellSize + offsetY);
+    }
+    inline vec2 cell_middle(int cx, int cy) const {
+        return vec2(((f32)cx + 0.5f) * cellSize + offsetX, ((f32)cy + 0.5f) * cellSize + offsetY);
+    }
+    // true if pos lands inside the grid, the cell is filled in either way
+    inline bool world_to_cell(vec2 pos, int& cx, int& cy) const {
+        // floor rather than truncate so the half cell left of and below the grid isn't folded into row 0
+        cx = math::floor_int((pos.x - offsetX) / cellSize);
+        cy = math::floor_int((pos.y - offsetY) / cellSize);
+        return contains(cx, cy);
+    }
+};
+
 class flow_field {
 public:
     flow_field(f32 worldWidth, f32 worldHeight, f32 cellSize, f32 offsetX, f32 offsetY);
+    // same cells as another grid over the world
+    explicit flow_field(const grid_layout& layout);
     void perlin_angles(const perlin_gen& perlin, f32 scale, f32 z = 0.f);
     void set(int cellX, int cellY, vec2 vec);
     vec2 get(int cx, int cy) const;
     vec2 get(vec2 pos) const;
     vec2 cell_center(int cx, int cy);
     static vec2 perlin_get(const perlin_gen& perlin, f32 x, f32 y, f32 z = 0.f);
+    // count points on one z slice through the batched noise, out[i] matches perlin_get(x[i], y[i], z)
+    static void perlin_get(const perlin_gen& perlin, const f32* x, const f32* y, f32 z, vec2* out, int count);
 
     int width() const;
     int height() const;
@@ -20,16 +55,13 @@ public:
 
     vec2 cell_to_world(int cx, int cy) const;
     bool world_to_cell(vec2 pos, int& cx, int& cy) const;
+    inline const grid_layout& layout() const { return grid; }
 
 private:
     inline int index(int x, int y) const;
 
     f32 worldWidth;
     f32 worldHeight;
-    f32 offsetX;
-    f32 offsetY;
-    f32 cellSize;
-    int cellWidth;
-    int cellHeight;
+    grid_layout grid;
     std::vector<vec2> vectors;
 };
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "goal_field.h"
+
+#include <algorithm>
+#include <limits>
+
+const f32 goal_field::UNREACHABLE = std::numeric_limits<f32>::max();
+
+goal_field::goal_field(const nav_grid& grid)
+    : grid(grid),
+    field(grid.layout())
+{
+    const int cells = grid.layout().cell_count();
+    integration.assign(cells, UNREACHABLE);
+    rhs.assign(cells, UNREACHABLE);
+    dirtyStamp.assign(cells, 0);
+}
+
+f32 goal_field::cost(int cx, int cy) const {
+    int i = grid.layout().index(cx, cy);
+    return (i >= 0) ? integration[i] : UNREACHABLE;
+}
+
+bool goal_field::update(const vec2& goal) {
+    const grid_layout& layout = grid.layout();
+    int gx, gy;
+    int cell = layout.world_to_cell(goal, gx, gy) ? layout.index(gx, gy) : -1;
+    if (cell == goalCell && grid.version() == solvedVersion) {
+        return false;
+    }
+
+    const int* changed = nullptr;
+    int changedCount = 0;
+    lastRepair = (cell == goalCell && cell >= 0 && grid.changes_since(solvedVersion, changed, changedCount));
+
+    goalCell = cell;
+    solvedVersion = grid.version();
+    if (lastRepair) {
+        repair(changed, changedCount);
+        ++repairs;
+    }
+    else {
+        solve();
+        ++solves;
+    }
+    return true;
+}
+
+void goal_field::push(f32 key, int cell) {
+    open.push_back({ key, cell });
+    std::push_heap(open.begin(), open.end(), [](const open_node& a, const open_node& b) {
+        return a.key > b.key;
+    });
+}
+
+void goal_field::solve() {
+    std::fill(integration.begin(), integration.end(), UNREACHABLE);
+    expanded = 0;
+
+    auto later = [](const open_node& a, const open_node& b) {
+        return a.key > b.key;
+    };
+
+    // runs backwards from the goal, stepping from cell into neighbour costs what walking from the
+    // neighbour into cell would, so the field matches what a* finds for the same pair
+    open.clear();
+    if (goalCell >= 0 && grid.cost(goalCell) != nav_grid::BLOCKED) {
+        integration[goalCell] = 0.f;
+        open.push_back({ 0.f, goalCell });
+    }
+
+    const int w = grid.width();
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), later);
+        const open_node node = open.back();
+        open.pop_back();
+
+        const int cell = node.cell;
+        if (node.key > integration[cell]) {
+            continue;
+        }
+        ++expanded;
+
+        const int cx = cell % w;
+        const int cy = cell / w;
+        const f32 enter = (f32)grid.cost(cell);
+        for (int k = 0; k < GRID_STEP_COUNT; ++k) {
+            if (!grid.can_step(cx, cy, k)) {
+                continue;
+            }
+
+            const int next = (cy + GRID_STEPS[k].dy) * w + cx + GRID_STEPS[k].dx;
+            const f32 nc = node.key + GRID_STEPS[k].length * enter;
+            if (nc < integration[next]) {
+                integration[next] = nc;
+                push(nc, next);
+            }
+        }
+    }
+
+    // everything settled, so the lookahead agrees everywhere
+    rhs = integration;
+    fullExpanded = expanded;
+
+    for (int cell = 0; cell < (int)integration.size(); ++cell) {
+        build_direction(cell);
+    }
+}
+
+f32 goal_field::lookahead(int cell) const {
+    if (grid.cost(cell) == nav_grid::BLOCKED) {
+        return UNREACHABLE;
+    }
+    if (cell == goalCell) {
+        return 0.f;
+    }
+
+    const int w = grid.width();
+    const int cx = cell % w;
+    const int cy = cell / w;
+    f32 best = UNREACHABLE;
+    for (int k = 0; k < GRID_STEP_COUNT; ++k) {
+        if (!grid.can_step(cx, cy, k)) {
+            continue;
+        }
+
+        const int next = (cy + GRID_STEPS[k].dy) * w + cx + GRID_STEPS[k].dx;
+        if (integration[next] != UNREACHABLE) {
+            best = math::min(best, integration[next] + GRID_STEPS[k].length * (f32)grid.cost(next));
+        }
+    }
+    return best;
+}
+
+void goal_field::update_cell(int cell) {
+    rhs[cell] = lookahead(cell);
+    if (integration[cell] != rhs[cell]) {
+        push(math::min(integration[cell], rhs[cell]), cell);
+    }
+}
+
+void goal_field::touch(int cell) {
+    const int w = grid.width();
+    const int cx = cell % w;
+    const int cy = cell / w;
+    for (int y = cy - 1; y <= cy + 1; ++y) {
+        for (int x = cx - 1; x <= cx + 1; ++x) {
+            int i = grid.layout().index(x, y);
+            if (i >= 0 && dirtyStamp[i] != stamp) {
+                dirtyStamp[i] = stamp;
+                dirty.push_back(i);
+            }
+        }
+    }
+}
+
+void goal_field::repair(const int* changed, int count) {
+    expanded = 0;
+    open.clear();
+    dirty.clear();
+    if (++stamp == 0) {
+        std::fill(dirtyStamp.begin(), dirtyStamp.end(), 0u);
+        stamp = 1;
+    }
+
+    auto later = [](const open_node& a, const open_node& b) {
+        return a.key > b.key;
+    };
+
+    // a changed cell alters its own lookahead, the cost of stepping into it and the corners of the
+    // diagonals around it, all of which sit inside its 3x3 block
+    const grid_layout& layout = grid.layout();
+    const int w = grid.width();
+    for (int c = 0; c < count; ++c) {
+        const int cx = changed[c] % w;
+        const int cy = changed[c] / w;
+        for (int y = cy - 1; y <= cy + 1; ++y) {
+            for (int x = cx - 1; x <= cx + 1; ++x) {
+                if (layout.contains(x, y)) {
+                    update_cell(y * w + x);
+                }
+            }
+        }
+        touch(changed[c]);
+    }
+
+    // cheaper cells settle like plain dijkstra, cells that got dearer drop to unreachable and are
+    // re-queued from whatever their neighbours still offer
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), later);
+        const open_node node = open.back();
+        open.pop_back();
+
+        const int cell = node.cell;
+        const f32 g = integration[cell];
+        if (g == rhs[cell] || node.key != math::min(g, rhs[cell])) {
+            continue;
+        }
+        ++expanded;
+
+        if (g > rhs[cell]) {
+            integration[cell] = rhs[cell];
+        }
+        else {
+            integration[cell] = UNREACHABLE;
+            update_cell(cell);
+        }
+        touch(cell);
+
+        const int cx = cell % w;
+        const int cy = cell / w;
+        for (int k = 0; k < GRID_STEP_COUNT; ++k) {
+            const int nx = cx + GRID_STEPS[k].dx;
+            const int ny = cy + GRID_STEPS[k].dy;
+            if (layout.contains(nx, ny)) {
+                update_cell(ny * w + nx);
+            }
+        }
+    }
+
+    for (int cell : dirty) {
+        build_direction(cell);
+    }
+}
+
+void goal_field::build_direction(int cell) {
+    const int w = grid.width();
+    const int cx = cell % w;
+    const int cy = cell / w;
+
+    // downhill to the cheapest neighbour, the goal cell and dead cells have nowhere to go
+    f32 best = integration[cell];
+    int bestK = -1;
+    if (best != UNREACHABLE && cell != goalCell) {
+        for (int k = 0; k < GRID_STEP_COUNT; ++k) {
+            if (!grid.can_step(cx, cy, k)) {
+                continue;
+            }
+            f32 c = integration[(cy + GRID_STEPS[k].dy) * w + cx + GRID_STEPS[k].dx];
+            if (c < best) {
+                best = c;
+                bestK = k;
+            }
+        }
+    }
+
+    vec2 dir = vec2::ZERO;
+    if (bestK >= 0) {
+        dir = vec2::normalize(vec2((f32)GRID_STEPS[bestK].dx, (f32)GRID_STEPS[bestK].dy));
+    }
+    field.set(cx, cy, dir);
+}
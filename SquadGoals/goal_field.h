@@ -0,0 +1,78 @@
+#pragma once
+
+#include "nav_grid.h"
+#include "flowfield.h"
+
+#include <vector>
+
+// every cell's way to one goal, solved once and shared by the whole crowd
+// a dijkstra pass out from the goal fills the integration field with each cell's cheapest cost to
+// reach it, using the same moves and costs as grid_astar, then every cell points at its cheapest
+// neighbour. agents steer with one flow_field lookup no matter how many share the goal.
+// a new goal cell solves from scratch, grid changes are repaired lpa* style: only cells whose cost
+// actually moves are re-expanded and only the directions around them rebuilt.
+// not thread safe to update, reads are fine from any thread between updates.
+
+class goal_field {
+public:
+    // the grid must outlive the field and keep its dimensions
+    goal_field(const nav_grid& grid);
+
+    // solves for a new goal cell or repairs after grid changes, true if anything was redone
+    bool update(const vec2& goal);
+    // the next update solves from scratch regardless
+    inline void invalidate() { goalCell = -1; }
+
+    // unit direction towards the goal, zero off the grid, in a blocked or unreachable cell and in the goal cell
+    inline vec2 direction(const vec2& pos) const { return field.get(pos); }
+    // cost to reach the goal from the cell, UNREACHABLE when there is no way
+    f32 cost(int cx, int cy) const;
+
+    inline const flow_field& directions() const { return field; }
+    inline int solve_count() const { return solves; }
+    inline int repair_count() const { return repairs; }
+    // cells expanded by the most recent update, and by the most recent from scratch solve to compare against
+    inline int last_expanded() const { return expanded; }
+    inline int full_expanded() const { return fullExpanded; }
+    inline bool last_was_repair() const { return lastRepair; }
+
+    static const f32 UNREACHABLE;
+
+private:
+    struct open_node {
+        f32 key;
+        int cell;
+    };
+
+    void solve();
+    void repair(const int* changed, int count);
+    // cheapest step into a neighbour plus its cost to the goal
+    f32 lookahead(int cell) const;
+    void update_cell(int cell);
+    void push(f32 key, int cell);
+    // the cell and its neighbours need their directions rebuilt
+    void touch(int cell);
+    void build_direction(int cell);
+
+    const nav_grid& grid;
+    flow_field field;
+
+    // settled cost to the goal and the one step lookahead, they differ only mid repair
+    std::vector<f32> integration;
+    std::vector<f32> rhs;
+    // binary min heap, stale entries are skipped when popped
+    std::vector<open_node> open;
+
+    std::vector<int> dirty;
+    std::vector<u32> dirtyStamp;
+    u32 stamp = 0;
+
+    int goalCell = -1;
+    u32 solvedVersion = 0;
+
+    int solves = 0;
+    int repairs = 0;
+    int expanded = 0;
+    int fullExpanded = 0;
+    bool lastRepair = false;
+};
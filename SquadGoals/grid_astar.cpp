@@ -0,0 +1,141 @@
+#include "grid_astar.h"
+#include "path_builder.h"
+
+#include <algorithm>
+
+grid_astar::grid_astar(const nav_grid& grid, int cacheCapacity)
+    : grid(grid),
+    cache(cacheCapacity),
+    cachedVersion(grid.version())
+{
+    const int cells = grid.layout().cell_count();
+    g.resize(cells);
+    parent.resize(cells);
+    seen.assign(cells, 0);
+    closed.assign(cells, 0);
+}
+
+void grid_astar::clear_cache() {
+    cache.clear();
+    cachedVersion = grid.version();
+}
+
+std::shared_ptr<const path> grid_astar::find(const vec2& start, const vec2& goal) {
+    if (grid.version() != cachedVersion) {
+        clear_cache();
+    }
+
+    const grid_layout& layout = grid.layout();
+    int sx, sy, gx, gy;
+    if (!layout.world_to_cell(start, sx, sy) || !layout.world_to_cell(goal, gx, gy)) {
+        return nullptr;
+    }
+    if (!grid.walkable(sx, sy) || !grid.walkable(gx, gy)) {
+        return nullptr;
+    }
+
+    const int startCell = layout.index(sx, sy);
+    const int goalCell = layout.index(gx, gy);
+    const u64 key = ((u64)(u32)startCell << 32) | (u32)goalCell;
+
+    if (const std::shared_ptr<const path>* cached = cache.find(key)) {
+        ++hits;
+        return *cached;
+    }
+
+    // unreachable goals are cached too, so a crowd stuck behind a wall asks once
+    std::shared_ptr<const path> route;
+    if (search(startCell, goalCell)) {
+        route = build_route();
+    }
+    cache.insert(key, route);
+
+    return route;
+}
+
+f32 grid_astar::heuristic(int cell, int goal) const {
+    const int w = grid.width();
+    return nav_grid::octile(cell % w - goal % w, cell / w - goal / w);
+}
+
+bool grid_astar::search(int start, int goal) {
+    ++searches;
+    expanded = 0;
+
+    // a wrapped stamp could match stale state from 2^32 searches ago, wipe it once instead
+    if (++stamp == 0) {
+        std::fill(seen.begin(), seen.end(), 0u);
+        std::fill(closed.begin(), closed.end(), 0u);
+        stamp = 1;
+    }
+
+    // lower f first, then deeper nodes so ties run on towards the goal instead of fanning out
+    auto later = [](const open_node& a, const open_node& b) {
+        return (a.f > b.f) || (a.f == b.f && a.g < b.g);
+    };
+
+    open.clear();
+    g[start] = 0.f;
+    parent[start] = -1;
+    seen[start] = stamp;
+    open.push_back({ heuristic(start, goal), 0.f, start });
+
+    const int w = grid.width();
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), later);
+        const open_node node = open.back();
+        open.pop_back();
+
+        const int cell = node.cell;
+        if (closed[cell] == stamp || node.g > g[cell]) {
+            continue;
+        }
+        closed[cell] = stamp;
+        ++expanded;
+
+        if (cell == goal) {
+            cellPath.clear();
+            for (int c = goal; c >= 0; c = parent[c]) {
+                cellPath.push_back(c);
+            }
+            std::reverse(cellPath.begin(), cellPath.end());
+            return true;
+        }
+
+        const int cx = cell % w;
+        const int cy = cell / w;
+        for (int k = 0; k < GRID_STEP_COUNT; ++k) {
+            if (!grid.can_step(cx, cy, k)) {
+                continue;
+            }
+
+            const int next = (cy + GRID_STEPS[k].dy) * w + cx + GRID_STEPS[k].dx;
+            if (closed[next] == stamp) {
+                continue;
+            }
+
+            const f32 ng = node.g + GRID_STEPS[k].length * (f32)grid.cost(next);
+            if (seen[next] != stamp || ng < g[next]) {
+                seen[next] = stamp;
+                g[next] = ng;
+                parent[next] = cell;
+                open.push_back({ ng + heuristic(next, goal), ng, next });
+                std::push_heap(open.begin(), open.end(), later);
+            }
+        }
+    }
+
+    return false;
+}
+
+std::shared_ptr<const path> grid_astar::build_route() const {
+    const grid_layout& layout = grid.layout();
+    const int w = grid.width();
+
+    // every cell on the way becomes a vertex, the builder folds straight runs back into one segment
+    path_builder builder;
+    for (int cell : cellPath) {
+        builder.add(layout.cell_middle(cell % w, cell / w));
+    }
+    return std::make_shared<path>(builder.build(path_dir::kCW, false));
+}
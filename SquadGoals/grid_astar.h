@@ -0,0 +1,65 @@
+#pragma once
+
+#include "nav_grid.h"
+#include "path.h"
+#include "lru_cache.h"
+
+#include <vector>
+#include <memory>
+
+// a* over a nav_grid, 8 connected and never cutting the corner of a blocked cell
+// node state lives in flat per cell arrays stamped with the search that last wrote them, so a
+// new search clears nothing, it just bumps the stamp. finished routes go into a small lru keyed
+// on (start cell, goal cell) and are shared by everyone asking the same question, the whole cache
+// drops as soon as the grid's version moves on.
+// not thread safe, one planner per thread.
+
+class grid_astar {
+public:
+    // the grid must outlive the planner and keep its dimensions
+    grid_astar(const nav_grid& grid, int cacheCapacity = 256);
+
+    // open path from the middle of start's cell to the middle of goal's with straight runs merged.
+    // null when either end is off the grid or blocked, or nothing connects them
+    std::shared_ptr<const path> find(const vec2& start, const vec2& goal);
+    void clear_cache();
+
+    inline int search_count() const { return searches; }
+    inline int cache_hits() const { return hits; }
+    inline int cache_size() const { return cache.size(); }
+    // nodes expanded by the most recent search
+    inline int last_expanded() const { return expanded; }
+
+private:
+    struct open_node {
+        f32 f;
+        f32 g;
+        int cell;
+    };
+
+    // fills cellPath from start to goal, false if the goal cant be reached
+    bool search(int start, int goal);
+    std::shared_ptr<const path> build_route() const;
+    f32 heuristic(int cell, int goal) const;
+
+    const nav_grid& grid;
+
+    // per cell search state, only meaningful where seen / closed match the current stamp
+    std::vector<f32> g;
+    std::vector<int> parent;
+    std::vector<u32> seen;
+    std::vector<u32> closed;
+    u32 stamp = 0;
+
+    // binary min heap on f, stale duplicates are skipped when popped instead of decreased in place
+    std::vector<open_node> open;
+    std::vector<int> cellPath;
+
+    // (start cell, goal cell) packed into one key
+    lru_cache<u64, std::shared_ptr<const path>> cache;
+    u32 cachedVersion;
+
+    int searches = 0;
+    int hits = 0;
+    int expanded = 0;
+};
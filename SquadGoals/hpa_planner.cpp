@@ -0,0 +1,529 @@
+#include "hpa_planner.h"
+#include "path_builder.h"
+
+#include <algorithm>
+#include <limits>
+
+static const f32 UNREACHABLE = std::numeric_limits<f32>::max();
+
+const int hpa_planner::WIDE_ENTRANCE;
+
+// lower f first, then deeper nodes so ties run on towards the goal
+static inline bool later_f(f32 fa, f32 ga, f32 fb, f32 gb) {
+    return (fa > fb) || (fa == fb && ga < gb);
+}
+
+hpa_planner::hpa_planner(const nav_grid& grid, int chunkSize, int cacheCapacity)
+    : grid(grid),
+    chunkSize((chunkSize > 1) ? chunkSize : 2),
+    cache(cacheCapacity)
+{
+    chunksX = (grid.width() + this->chunkSize - 1) / this->chunkSize;
+    chunksY = (grid.height() + this->chunkSize - 1) / this->chunkSize;
+
+    const int cells = grid.layout().cell_count();
+    localDist.resize(cells);
+    localParent.resize(cells);
+    localSeen.assign(cells, 0);
+    localDone.assign(cells, 0);
+
+    build_all();
+}
+
+int hpa_planner::chunk_of(int cell) const {
+    const int w = grid.width();
+    return (cell / w / chunkSize) * chunksX + (cell % w) / chunkSize;
+}
+
+void hpa_planner::build_all() {
+    const int chunks = chunk_count();
+    nodes.clear();
+    freeNodes.clear();
+    liveNodes = 0;
+    eastBorder.assign(chunks, std::vector<int>());
+    northBorder.assign(chunks, std::vector<int>());
+    chunkNodes.assign(chunks, std::vector<int>());
+
+    for (int c = 0; c < chunks; ++c) {
+        build_border(c, true);
+        build_border(c, false);
+    }
+    for (int c = 0; c < chunks; ++c) {
+        link_chunk(c);
+    }
+
+    rebuiltChunks = chunks;
+    syncedVersion = grid.version();
+    cache.clear();
+    cachedVersion = grid.version();
+}
+
+int hpa_planner::add_node(int cell, int chunk) {
+    int id;
+    if (!freeNodes.empty()) {
+        id = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else {
+        id = (int)nodes.size();
+        nodes.push_back(node());
+    }
+
+    node& n = nodes[id];
+    n.cell = cell;
+    n.chunk = chunk;
+    n.partner = -1;
+    n.intra.clear();
+    ++liveNodes;
+    return id;
+}
+
+void hpa_planner::clear_border(std::vector<int>& border) {
+    for (int id : border) {
+        nodes[id].partner = -1;
+        nodes[id].intra.clear();
+        freeNodes.push_back(id);
+        --liveNodes;
+    }
+    border.clear();
+}
+
+void hpa_planner::build_border(int chunk, bool east) {
+    std::vector<int>& border = east ? eastBorder[chunk] : northBorder[chunk];
+    clear_border(border);
+
+    const int cx = chunk % chunksX;
+    const int cy = chunk / chunksX;
+    if ((east && cx + 1 >= chunksX) || (!east && cy + 1 >= chunksY)) {
+        return;
+    }
+
+    // walk along the border, a is the cell on this side and b the one across
+    const int w = grid.width();
+    const int along = east ? grid.height() : w;
+    const int first = (east ? cy : cx) * chunkSize;
+    const int last = std::min(first + chunkSize, along);
+    const int across = (east ? cx + 1 : cy + 1) * chunkSize;
+    const int other = east ? chunk + 1 : chunk + chunksX;
+
+    auto cells = [east, across, w](int t, int& a, int& b) {
+        a = east ? (t * w + across - 1) : ((across - 1) * w + t);
+        b = east ? (t * w + across) : (across * w + t);
+    };
+
+    auto add_transition = [this, &border, &cells, chunk, other](int t) {
+        int a, b;
+        cells(t, a, b);
+        int na = add_node(a, chunk);
+        int nb = add_node(b, other);
+        nodes[na].partner = nb;
+        nodes[nb].partner = na;
+        border.push_back(na);
+        border.push_back(nb);
+    };
+
+    int runStart = -1;
+    for (int t = first; t <= last; ++t) {
+        bool open = false;
+        if (t < last) {
+            int a, b;
+            cells(t, a, b);
+            open = grid.cost(a) != nav_grid::BLOCKED && grid.cost(b) != nav_grid::BLOCKED;
+        }
+
+        if (open && runStart < 0) {
+            runStart = t;
+        }
+        else if (!open && runStart >= 0) {
+            const int runEnd = t - 1;
+            if (runEnd - runStart + 1 >= WIDE_ENTRANCE) {
+                add_transition(runStart);
+                add_transition(runEnd);
+            }
+            else {
+                add_transition((runStart + runEnd) / 2);
+            }
+            runStart = -1;
+        }
+    }
+}
+
+void hpa_planner::link_chunk(int chunk) {
+    const int cx = chunk % chunksX;
+    const int cy = chunk / chunksX;
+
+    std::vector<int>& inside = chunkNodes[chunk];
+    inside.clear();
+    auto gather = [this, &inside, chunk](const std::vector<int>& border) {
+        for (int id : border) {
+            if (nodes[id].chunk == chunk) {
+                inside.push_back(id);
+            }
+        }
+    };
+    gather(eastBorder[chunk]);
+    gather(northBorder[chunk]);
+    if (cx > 0) {
+        gather(eastBorder[chunk - 1]);
+    }
+    if (cy > 0) {
+        gather(northBorder[chunk - chunksX]);
+    }
+
+    for (int id : inside) {
+        node& from = nodes[id];
+        from.intra.clear();
+        local_search(from.cell, chunk, false);
+        for (int to : inside) {
+            if (to != id && local_reached(nodes[to].cell)) {
+                from.intra.push_back({ to, localDist[nodes[to].cell] });
+            }
+        }
+    }
+}
+
+void hpa_planner::local_search(int source, int chunk, bool backward, int target) {
+    if (++localStamp == 0) {
+        std::fill(localSeen.begin(), localSeen.end(), 0u);
+        std::fill(localDone.begin(), localDone.end(), 0u);
+        localStamp = 1;
+    }
+
+    auto later = [](const open_node& a, const open_node& b) {
+        return later_f(a.f, a.g, b.f, b.g);
+    };
+
+    open.clear();
+    localDist[source] = 0.f;
+    localParent[source] = -1;
+    localSeen[source] = localStamp;
+    open.push_back({ 0.f, 0.f, source });
+
+    const int w = grid.width();
+    const int minX = (chunk % chunksX) * chunkSize;
+    const int minY = (chunk / chunksX) * chunkSize;
+    const int maxX = minX + chunkSize;
+    const int maxY = minY + chunkSize;
+
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), later);
+        const open_node top = open.back();
+        open.pop_back();
+
+        const int cell = top.id;
+        if (localDone[cell] == localStamp || top.g > localDist[cell]) {
+            continue;
+        }
+        localDone[cell] = localStamp;
+        if (cell == target) {
+            return;
+        }
+
+        const int cx = cell % w;
+        const int cy = cell / w;
+        for (int k = 0; k < GRID_STEP_COUNT; ++k) {
+            const int nx = cx + GRID_STEPS[k].dx;
+            const int ny = cy + GRID_STEPS[k].dy;
+            if (nx < minX || nx >= maxX || ny < minY || ny >= maxY || !grid.can_step(cx, cy, k)) {
+                continue;
+            }
+
+            // forward pays for entering the neighbour, backward for entering this cell from it
+            const int next = ny * w + nx;
+            const f32 enter = (f32)grid.cost(backward ? cell : next);
+            const f32 nd = top.g + GRID_STEPS[k].length * enter;
+            if (localSeen[next] != localStamp || nd < localDist[next]) {
+                localSeen[next] = localStamp;
+                localDist[next] = nd;
+                localParent[next] = cell;
+                open.push_back({ nd, nd, next });
+                std::push_heap(open.begin(), open.end(), later);
+            }
+        }
+    }
+}
+
+void hpa_planner::sync() {
+    if (grid.version() == syncedVersion) {
+        return;
+    }
+
+    const int* changed = nullptr;
+    int count = 0;
+    if (!grid.changes_since(syncedVersion, changed, count)) {
+        build_all();
+        return;
+    }
+    syncedVersion = grid.version();
+
+    // every chunk an edit landed in rebuilds its four borders, which changes the node sets of the
+    // chunks across them, so those relink too. nothing further out is touched
+    const int chunks = chunk_count();
+    std::vector<u8> dirty(chunks, 0);
+    std::vector<u8> relink(chunks, 0);
+    for (int k = 0; k < count; ++k) {
+        dirty[chunk_of(changed[k])] = 1;
+    }
+
+    for (int c = 0; c < chunks; ++c) {
+        if (!dirty[c]) {
+            continue;
+        }
+        const int cx = c % chunksX;
+        const int cy = c / chunksX;
+
+        build_border(c, true);
+        build_border(c, false);
+        relink[c] = 1;
+        if (cx + 1 < chunksX) {
+            relink[c + 1] = 1;
+        }
+        if (cy + 1 < chunksY) {
+            relink[c + chunksX] = 1;
+        }
+        if (cx > 0) {
+            if (!dirty[c - 1]) {
+                build_border(c - 1, true);
+            }
+            relink[c - 1] = 1;
+        }
+        if (cy > 0) {
+            if (!dirty[c - chunksX]) {
+                build_border(c - chunksX, false);
+            }
+            relink[c - chunksX] = 1;
+        }
+    }
+
+    rebuiltChunks = 0;
+    for (int c = 0; c < chunks; ++c) {
+        if (relink[c]) {
+            link_chunk(c);
+            ++rebuiltChunks;
+        }
+    }
+}
+
+std::shared_ptr<hpa_plan> hpa_planner::find(const vec2& start, const vec2& goal) {
+    sync();
+    if (grid.version() != cachedVersion) {
+        cache.clear();
+        cachedVersion = grid.version();
+    }
+
+    const grid_layout& layout = grid.layout();
+    int sx, sy, gx, gy;
+    if (!layout.world_to_cell(start, sx, sy) || !layout.world_to_cell(goal, gx, gy)) {
+        return nullptr;
+    }
+    if (!grid.walkable(sx, sy) || !grid.walkable(gx, gy)) {
+        return nullptr;
+    }
+
+    const int startCell = layout.index(sx, sy);
+    const int goalCell = layout.index(gx, gy);
+    const u64 key = ((u64)(u32)startCell << 32) | (u32)goalCell;
+
+    if (const std::shared_ptr<hpa_plan>* cached = cache.find(key)) {
+        ++hits;
+        return *cached;
+    }
+
+    std::shared_ptr<hpa_plan> plan;
+    std::vector<int> waypoints;
+    if (abstract_search(startCell, goalCell, waypoints)) {
+        plan = std::make_shared<hpa_plan>();
+        plan->waypoints.swap(waypoints);
+        plan->version = grid.version();
+        // a crossing opens a new leg once the current one has gone somewhere inside a chunk, so
+        // back to back crossings at chunk corners stay together too
+        const std::vector<int>& points = plan->waypoints;
+        bool walked = false;
+        for (int j = 0; j + 1 < (int)points.size(); ++j) {
+            const bool crossing = (chunk_of(points[j]) != chunk_of(points[j + 1]));
+            if (j == 0 || (crossing && walked)) {
+                plan->legStarts.push_back(j);
+                walked = false;
+            }
+            walked = walked || !crossing;
+        }
+        plan->legs.resize(plan->legStarts.size());
+    }
+    cache.insert(key, plan);
+
+    return plan;
+}
+
+bool hpa_planner::abstract_search(int startCell, int goalCell, std::vector<int>& waypoints) {
+    ++searches;
+    expanded = 0;
+
+    const int startChunk = chunk_of(startCell);
+    const int goalChunk = chunk_of(goalCell);
+    const int count = (int)nodes.size();
+    const int startId = count;
+    const int goalId = count + 1;
+
+    // start links to the nodes its chunk reaches, and straight to the goal if that shares the chunk
+    startEdges.clear();
+    local_search(startCell, startChunk, false);
+    for (int id : chunkNodes[startChunk]) {
+        if (local_reached(nodes[id].cell)) {
+            startEdges.push_back({ id, localDist[nodes[id].cell] });
+        }
+    }
+    if (startChunk == goalChunk && local_reached(goalCell)) {
+        startEdges.push_back({ goalId, localDist[goalCell] });
+    }
+
+    absG.resize(count + 2);
+    absParent.resize(count + 2);
+    absSeen.resize(count + 2, 0);
+    absDone.resize(count + 2, 0);
+    goalCost.resize(count + 2);
+    goalSeen.resize(count + 2, 0);
+    if (++absStamp == 0) {
+        std::fill(absSeen.begin(), absSeen.end(), 0u);
+        std::fill(absDone.begin(), absDone.end(), 0u);
+        std::fill(goalSeen.begin(), goalSeen.end(), 0u);
+        absStamp = 1;
+    }
+
+    // and the goal's chunk nodes link to it by what it costs them to get there
+    local_search(goalCell, goalChunk, true);
+    for (int id : chunkNodes[goalChunk]) {
+        if (local_reached(nodes[id].cell)) {
+            goalCost[id] = localDist[nodes[id].cell];
+            goalSeen[id] = absStamp;
+        }
+    }
+
+    const int w = grid.width();
+    auto heuristic = [this, w, goalCell, startCell, startId, goalId](int id) {
+        int cell = (id == startId) ? startCell : (id == goalId) ? goalCell : nodes[id].cell;
+        return nav_grid::octile(cell % w - goalCell % w, cell / w - goalCell / w);
+    };
+    auto later = [](const open_node& a, const open_node& b) {
+        return later_f(a.f, a.g, b.f, b.g);
+    };
+
+    open.clear();
+    absG[startId] = 0.f;
+    absParent[startId] = -1;
+    absSeen[startId] = absStamp;
+    open.push_back({ heuristic(startId), 0.f, startId });
+
+    auto relax = [this, &heuristic, &later](int from, int to, f32 g) {
+        if (absDone[to] == absStamp) {
+            return;
+        }
+        if (absSeen[to] != absStamp || g < absG[to]) {
+            absSeen[to] = absStamp;
+            absG[to] = g;
+            absParent[to] = from;
+            open.push_back({ g + heuristic(to), g, to });
+            std::push_heap(open.begin(), open.end(), later);
+        }
+    };
+
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), later);
+        const open_node top = open.back();
+        open.pop_back();
+
+        const int id = top.id;
+        if (absDone[id] == absStamp || top.g > absG[id]) {
+            continue;
+        }
+        absDone[id] = absStamp;
+        ++expanded;
+
+        if (id == goalId) {
+            std::vector<int> ids;
+            for (int at = goalId; at >= 0; at = absParent[at]) {
+                ids.push_back(at);
+            }
+            waypoints.clear();
+            for (auto it = ids.rbegin(); it != ids.rend(); ++it) {
+                int cell = (*it == startId) ? startCell : (*it == goalId) ? goalCell : nodes[*it].cell;
+                // the start or goal can sit right on an entrance
+                if (waypoints.empty() || waypoints.back() != cell) {
+                    waypoints.push_back(cell);
+                }
+            }
+            return true;
+        }
+
+        if (id == startId) {
+            for (const edge& e : startEdges) {
+                relax(id, e.to, top.g + e.cost);
+            }
+            continue;
+        }
+
+        const node& n = nodes[id];
+        for (const edge& e : n.intra) {
+            relax(id, e.to, top.g + e.cost);
+        }
+        if (n.partner >= 0) {
+            relax(id, n.partner, top.g + (f32)grid.cost(nodes[n.partner].cell));
+        }
+        if (goalSeen[id] == absStamp) {
+            relax(id, goalId, top.g + goalCost[id]);
+        }
+    }
+
+    return false;
+}
+
+std::shared_ptr<const path> hpa_planner::leg(hpa_plan& plan, int k) {
+    if (k < 0 || k >= plan.leg_count()) {
+        return nullptr;
+    }
+    if (plan.legs[k] != nullptr) {
+        return plan.legs[k];
+    }
+    // the abstract route may run through cells that have since been blocked
+    if (plan.version != grid.version()) {
+        return nullptr;
+    }
+
+    const grid_layout& layout = grid.layout();
+    const int w = grid.width();
+    const int first = plan.legStarts[k];
+    const int last = (k + 1 < plan.leg_count()) ? plan.legStarts[k + 1] : (int)plan.waypoints.size() - 1;
+
+    path_builder builder;
+    builder.add(layout.cell_middle(plan.waypoints[first] % w, plan.waypoints[first] / w));
+    for (int j = first; j < last; ++j) {
+        const int from = plan.waypoints[j];
+        const int to = plan.waypoints[j + 1];
+
+        if (chunk_of(from) != chunk_of(to)) {
+            // a border crossing, the two cells are neighbours
+            if (grid.cost(from) == nav_grid::BLOCKED || grid.cost(to) == nav_grid::BLOCKED) {
+                return nullptr;
+            }
+            builder.add(layout.cell_middle(to % w, to / w));
+            continue;
+        }
+
+        local_search(from, chunk_of(from), false, to);
+        if (!local_reached(to)) {
+            return nullptr;
+        }
+
+        // from is already in, add the rest in order
+        std::vector<int> cells;
+        for (int c = to; c != from; c = localParent[c]) {
+            cells.push_back(c);
+        }
+        for (auto it = cells.rbegin(); it != cells.rend(); ++it) {
+            builder.add(layout.cell_middle(*it % w, *it / w));
+        }
+    }
+
+    ++refined;
+    plan.legs[k] = std::make_shared<path>(builder.build(path_dir::kCW, false));
+    return plan.legs[k];
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "nav_grid.h"
+#include "path.h"
+#include "lru_cache.h"
+
+#include <vector>
+#include <memory>
+
+// abstract route from hpa_planner, consecutive waypoints either share a chunk or face each other
+// across a chunk border. a leg starts at a border crossing and runs on through the next chunk, so
+// no leg is just the single step over a border. legs are refined into cell paths the first time
+// anyone asks for them and kept, so agents sharing a plan refine each leg once
+struct hpa_plan {
+    std::vector<int> waypoints;
+    // index of each leg's first waypoint, a leg ends where the next begins or at the last waypoint
+    std::vector<int> legStarts;
+    std::vector<std::shared_ptr<const path>> legs;
+    // grid version the plan was searched on
+    u32 version = 0;
+
+    inline int leg_count() const { return (int)legStarts.size(); }
+};
+
+// hierarchical a* over square chunks of a nav_grid
+// every run of open cells along a chunk border gets an entrance, a node either side linked by the
+// step across, and the nodes of each chunk are linked to each other by their in-chunk path costs.
+// long queries only search that small graph, and each leg is refined by a search confined to one
+// chunk once an agent gets to it. grid edits rebuild just the chunks they land in and the borders
+// around them, picked up from the grid's change log on the next query.
+// not thread safe, one planner per thread.
+
+class hpa_planner {
+public:
+    // the grid must outlive the planner and keep its dimensions
+    hpa_planner(const nav_grid& grid, int chunkSize = 16, int cacheCapacity = 256);
+
+    // abstract plan from start's cell to goal's, null when either end is off the grid or blocked or
+    // nothing connects them. plans are cached by (start cell, goal cell) until the grid changes
+    std::shared_ptr<hpa_plan> find(const vec2& start, const vec2& goal);
+    // leg k of the plan as an open path, null if out of range or the grid changed under the plan
+    std::shared_ptr<const path> leg(hpa_plan& plan, int k);
+    // brings the abstract graph up to date with the grid, find does this itself
+    void sync();
+
+    inline int chunk_size() const { return chunkSize; }
+    inline int chunk_count() const { return chunksX * chunksY; }
+    inline int entrance_nodes() const { return liveNodes; }
+    // chunks relinked by the most recent sync that had anything to do
+    inline int chunks_rebuilt() const { return rebuiltChunks; }
+    // abstract nodes expanded by the most recent search
+    inline int last_expanded() const { return expanded; }
+    inline int legs_refined() const { return refined; }
+    inline int search_count() const { return searches; }
+    inline int cache_hits() const { return hits; }
+
+    // border runs at least this long get a transition at each end instead of one in the middle
+    static const int WIDE_ENTRANCE = 6;
+
+private:
+    struct edge {
+        int to;
+        f32 cost;
+    };
+
+    struct node {
+        int cell;
+        int chunk;
+        // the node across the border, -1 for a free slot
+        int partner;
+        std::vector<edge> intra;
+    };
+
+    struct open_node {
+        f32 f;
+        f32 g;
+        int id;
+    };
+
+    int chunk_of(int cell) const;
+    void build_all();
+    // entrances across the border east of chunk, or north of it
+    void build_border(int chunk, bool east);
+    void clear_border(std::vector<int>& border);
+    int add_node(int cell, int chunk);
+    // gathers the chunk's nodes and links every pair by its in-chunk cost
+    void link_chunk(int chunk);
+    // dijkstra from source without leaving chunk. forward fills the cost from source to each cell,
+    // backward the cost from each cell to source. stops once target is settled
+    void local_search(int source, int chunk, bool backward, int target = -1);
+    inline bool local_reached(int cell) const { return localSeen[cell] == localStamp; }
+    bool abstract_search(int startCell, int goalCell, std::vector<int>& waypoints);
+
+    const nav_grid& grid;
+    int chunkSize;
+    int chunksX;
+    int chunksY;
+
+    std::vector<node> nodes;
+    std::vector<int> freeNodes;
+    int liveNodes = 0;
+    // both sides of every entrance on the border east and north of each chunk
+    std::vector<std::vector<int>> eastBorder;
+    std::vector<std::vector<int>> northBorder;
+    std::vector<std::vector<int>> chunkNodes;
+    u32 syncedVersion;
+
+    // local search state, only meaningful where stamped with the current search
+    std::vector<f32> localDist;
+    std::vector<int> localParent;
+    std::vector<u32> localSeen;
+    std::vector<u32> localDone;
+    u32 localStamp = 0;
+
+    // abstract search state, start and goal ride along as the two ids past the last node
+    std::vector<f32> absG;
+    std::vector<int> absParent;
+    std::vector<u32> absSeen;
+    std::vector<u32> absDone;
+    std::vector<f32> goalCost;
+    std::vector<u32> goalSeen;
+    u32 absStamp = 0;
+    std::vector<edge> startEdges;
+
+    // one heap for both searches, ids are cells in local searches and nodes in abstract ones
+    std::vector<open_node> open;
+
+    lru_cache<u64, std::shared_ptr<hpa_plan>> cache;
+    u32 cachedVersion;
+
+    int rebuiltChunks = 0;
+    int expanded = 0;
+    int refined = 0;
+    int searches = 0;
+    int hits = 0;
+};
@@ -0,0 +1,122 @@
+#include "job_system.h"
+
+job_system::job_system(int threadCount)
+    : queuedJobs(0)
+{
+    if (threadCount <= 0) {
+        threadCount = (int)std::thread::hardware_concurrency();
+        if (threadCount <= 0) {
+            threadCount = 1;
+        }
+    }
+
+    queues = std::vector<worker_queue>(threadCount);
+
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&job_system::worker_main, this, i);
+    }
+}
+
+job_system::~job_system() {
+    {
+        std::lock_guard<std::mutex> lk(sleepLock);
+        quit = true;
+    }
+    wake.notify_all();
+
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+void job_system::submit_and_wait(void (*run)(void*, int, int), void* ctx, int first, int last, int grain) {
+    const int chunkCount = (last - first + grain - 1) / grain;
+    std::atomic<int> pending(chunkCount);
+
+    // hand each queue a contiguous run of chunks so neighbouring work stays on one core until stolen
+    const int queueCount = (int)queues.size();
+    const int perQueue = (chunkCount + queueCount - 1) / queueCount;
+    for (int q = 0; q < queueCount; ++q) {
+        int chunkBegin = q * perQueue;
+        int chunkEnd = (chunkBegin + perQueue < chunkCount) ? chunkBegin + perQueue : chunkCount;
+        if (chunkBegin >= chunkEnd) {
+            break;
+        }
+
+        std::lock_guard<std::mutex> lk(queues[q].lock);
+        for (int c = chunkBegin; c < chunkEnd; ++c) {
+            int begin = first + c * grain;
+            int end = (begin + grain < last) ? begin + grain : last;
+            queues[q].jobs.push_back(job{ run, ctx, begin, end, &pending });
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(sleepLock);
+        queuedJobs += chunkCount;
+    }
+    wake.notify_all();
+
+    // help out until our batch is done, possibly running other batches' chunks meanwhile
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (!try_run_one(0)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool job_system::try_run_one(int self) {
+    job j;
+    if (!pop(self, j) && !steal(self, j)) {
+        return false;
+    }
+
+    j.run(j.ctx, j.begin, j.end);
+    j.pending->fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+bool job_system::pop(int queue, job& out) {
+    worker_queue& q = queues[queue];
+    std::lock_guard<std::mutex> lk(q.lock);
+    if (q.jobs.empty()) {
+        return false;
+    }
+
+    out = q.jobs.back();
+    q.jobs.pop_back();
+    --queuedJobs;
+    return true;
+}
+
+bool job_system::steal(int thief, job& out) {
+    const int queueCount = (int)queues.size();
+    for (int i = 1; i < queueCount; ++i) {
+        worker_queue& q = queues[(thief + i) % queueCount];
+        std::lock_guard<std::mutex> lk(q.lock);
+        if (q.jobs.empty()) {
+            continue;
+        }
+
+        out = q.jobs.front();
+        q.jobs.pop_front();
+        --queuedJobs;
+        return true;
+    }
+    return false;
+}
+
+void job_system::worker_main(int self) {
+    for (;;) {
+        if (try_run_one(self)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lk(sleepLock);
+        wake.wait(lk, [this] { return quit || queuedJobs.load() > 0; });
+        if (quit) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "types.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// small work stealing thread pool
+// every worker owns a queue, pops its own work from the back and steals from the front of the
+// others when it runs dry. the thread calling parallel_for works on the batch too, so a pool
+// with zero workers degrades to a plain serial loop.
+
+class job_system {
+public:
+    // threadCount counts the calling thread, 0 picks one per hardware thread
+    explicit job_system(int threadCount = 0);
+    ~job_system();
+
+    job_system(const job_system&) = delete;
+    job_system& operator=(const job_system&) = delete;
+
+    // calls fn(begin, end) over [first, last) split into chunks of at most grain, returns when all chunks are done
+    template <typename F>
+    void parallel_for(int first, int last, int grain, F&& fn);
+
+    inline int thread_count() const { return (int)workers.size() + 1; }
+
+private:
+    struct job {
+        void (*run)(void* ctx, int begin, int end);
+        void* ctx;
+        int begin;
+        int end;
+        std::atomic<int>* pending;
+    };
+
+    struct worker_queue {
+        std::mutex lock;
+        std::deque<job> jobs;
+    };
+
+    void submit_and_wait(void (*run)(void*, int, int), void* ctx, int first, int last, int grain);
+    bool try_run_one(int self);
+    bool pop(int queue, job& out);
+    bool steal(int thief, job& out);
+    void worker_main(int self);
+
+    // queue 0 belongs to the calling thread, queue i + 1 to workers[i]
+    std::vector<worker_queue> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::atomic<int> queuedJobs;
+    bool quit = false;
+};
+
+template <typename F>
+void job_system::parallel_for(int first, int last, int grain, F&& fn) {
+    if (last <= first) {
+        return;
+    }
+
+    typedef typename std::remove_reference<F>::type fn_type;
+    auto trampoline = [](void* ctx, int begin, int end) {
+        (*(fn_type*)ctx)(begin, end);
+    };
+
+    submit_and_wait(trampoline, (void*)&fn, first, last, (grain > 0) ? grain : 1);
+}
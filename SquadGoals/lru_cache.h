@@ -0,0 +1,60 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+
+// fixed capacity map that forgets the least recently used entry once full
+// lookups count as a use. values are copied in and out, so keep them cheap, a shared_ptr say.
+
+template <typename K, typename V>
+class lru_cache {
+public:
+    explicit lru_cache(int capacity)
+        : capacity((capacity > 0) ? capacity : 1)
+    {
+    }
+
+    // null if absent, otherwise the value, now the most recently used
+    const V* find(const K& key) {
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            return nullptr;
+        }
+        order.splice(order.begin(), order, it->second.order);
+        return &it->second.value;
+    }
+
+    void insert(const K& key, const V& value) {
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            it->second.value = value;
+            order.splice(order.begin(), order, it->second.order);
+            return;
+        }
+
+        order.push_front(key);
+        entries.emplace(key, entry{ value, order.begin() });
+        if ((int)order.size() > capacity) {
+            entries.erase(order.back());
+            order.pop_back();
+        }
+    }
+
+    void clear() {
+        order.clear();
+        entries.clear();
+    }
+
+    inline int size() const { return (int)order.size(); }
+
+private:
+    struct entry {
+        V value;
+        typename std::list<K>::iterator order;
+    };
+
+    int capacity;
+    // most recently used at the front
+    std::list<K> order;
+    std::unordered_map<K, entry> entries;
+};
@@ -2,15 +2,13 @@
 #include <random>
 #include <iostream>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
 
-#include <Box2D/Box2D.h>
-
-#include <effolkronium/random.hpp>
-
 #include "algebra.h"
 #include "perlin.h"
 #include "flowfield.h"
@@ -19,99 +17,69 @@
 #include "input_state.h"
 #include "renderer.h"
 #include "flatdraw.h"
+#include "steer_sim.h"
+#include "quadtree.h"
 
 #include "imgui.h"
 #include "imgui_impl_sdl.h"
 #include "imgui_impl_opengl3.h"
 
-enum class agent_seek_mode {
-    kWander,
-    kFollowPath,
-    kReturn,
-    kCount,
-};
-
-const char* seek_mode_strs[(int)agent_seek_mode::kCount] {
-    "wander",
-    "follow path",
-    "return"
-};
-
 struct debug_config {
     bool showWanderProjection = false;
     bool showTarget = false;
     bool showSeparationRadius = false;
     bool showPath = false;
     bool showFlowField = false;
+    bool showQuadTree = false;
+    bool showLod = false;
+    bool showNav = false;
 };
 
-struct agent_config {
-    agent_seek_mode seekMode = agent_seek_mode::kFollowPath;
-    
-    f32 maxSpeed = 10.f;
-    f32 maxAccel = 5.f;
-    
-    f32 wanderProjectionDist = 4.f;
-    f32 wanderProjectionRadius = 1.f;
-    
-    f32 wanderAngleRange = 4.f;
-    f32 wanderInterval = 1 / 30.f;
-    
-    f32 separationDist = 2.f;
-
-    f32 movementScalar = 1.f;
-    f32 flowScalar = 0.f;
-    f32 separationScalar = 0.1f;
-
-    f32 pathFollowDist = 1.5f;
-};
-
-struct steer_agent {
-    vec2 position = vec2::ZERO;
-    vec2 velocity = vec2::ZERO;
-    vec2 acceleration = vec2::ZERO;
-    f32 rotation = 0;
-
-    vec2 target = vec2::ZERO;
-
-    vec2 future;
-    f32 wanderAngle;
-    f32 wanderTimer = 0.f;
-
-    b2Body* body;
-};
-
-struct world_data {
-    f32 flowDivisor = 32.f;
-    f32 flowDepth = 0.f;
-};
-
-static void init_agent(steer_agent& ag, b2World& world) {
-    b2BodyDef bodyDef;
-    bodyDef.type = b2_dynamicBody;
-    bodyDef.position.Set(0.0f, 4.0f);
-    ag.body = world.CreateBody(&bodyDef);
-
-
-    b2CircleShape shapeDef;
-    shapeDef.m_radius = 0.25f;
-
-    b2FixtureDef fixtureDef;
-    fixtureDef.shape = &shapeDef;
-    fixtureDef.density = 1.0f;
-    fixtureDef.friction = 0.3f;
-
-    ag.body->CreateFixture(&fixtureDef);
-    ag.body->SetTransform(ag.position, ag.rotation);
-}
-
-using Random = effolkronium::random_static;
-
 vec2 ray_ground_intersection(const glm::vec3& origin, const glm::vec3& direction);
 void draw_aabb(flat_draw_context& ctx, const aabb& box);
+int run_headless(int tickCount, bool ramp, integrator_mode integrator);
+int verify_noise();
+int verify_worker_routes();
+int verify_kinematics();
 
 int main(int argc, char* argv[]) {
-    Random::seed(1);
+    // --headless <ticks> steps the simulation without a window, unthrottled by vsync
+    // --ramp additionally times each agent count from 10 up to 100k on the same world
+    // --integrator box2d|euler|verlet picks how agents move
+    // --verify-noise checks the batched perlin paths against the scalar one and exits
+    // --verify-routes checks the route worker never delivers a route planned on a grid edited since
+    // --verify-kinematics checks the kinematic integrators match a single threaded run and keep agents apart
+    bool ramp = false;
+    int headlessTicks = -1;
+    integrator_mode integrator = integrator_mode::kBox2D;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            headlessTicks = (i + 1 < argc) ? atoi(argv[i + 1]) : 1000;
+        }
+        else if (strcmp(argv[i], "--ramp") == 0) {
+            ramp = true;
+        }
+        else if (strcmp(argv[i], "--verify-routes") == 0) {
+            return verify_worker_routes();
+        }
+        else if (strcmp(argv[i], "--verify-kinematics") == 0) {
+            return verify_kinematics();
+        }
+        else if (strcmp(argv[i], "--verify-noise") == 0) {
+            return verify_noise();
+        }
+        else if (strcmp(argv[i], "--integrator") == 0 && i + 1 < argc) {
+            for (int m = 0; m < (int)integrator_mode::kCount; ++m) {
+                if (strcmp(argv[i + 1], integrator_mode_strs[m]) == 0) {
+                    integrator = (integrator_mode)m;
+                }
+            }
+        }
+    }
+    if (headlessTicks >= 0) {
+        return run_headless(headlessTicks, ramp, integrator);
+    }
+
     input_state input;
 
     SDL_Init(SDL_INIT_VIDEO);
@@ -141,52 +109,30 @@ int main(int argc, char* argv[]) {
     camera camCopy = cam;
     //cam.position = glm::vec3(0.f, 20.f, 0.f);
 
-    std::vector<vec2> pathPts;
-    const int ptCount = 20;
-    const f32 delta = 360.f / ptCount;
-    const f32 radX = 12, radY = 9;
-    for (int i = 0; i < ptCount; ++i) {
-        f32 a = delta * i;
-        f32 b = delta * (i + 1);
-        pathPts.push_back(vec2(math::cos(a) * radX, math::sin(a) * radY));
-        pathPts.push_back(vec2(math::cos(b) * radX, math::sin(b) * radY));
-    }
-
-    path agentPath(path_dir::kCW, pathPts.data(), pathPts.size());
-
-    b2World physicsWorld(vec2::ZERO);
-
     //box2dSdlDebugDraw sdlDebugDraw(renderer);
     //world.SetDebugDraw(&sdlDebugDraw);
 
-    const i32 velocityIterations = 8;
-    const i32 positionIterations = 8;
-
     /*SDL_Surface* dudeSurface = IMG_Load("assets/dude.png");
     SDL_Texture* dudeTexture = SDL_CreateTextureFromSurface(renderer, dudeSurface);*/
 
     debug_config debugConfig;
-    agent_config agentConfig;
-    world_data world;
 
-    std::vector<steer_agent> agents;
-    steer_agent* selected = nullptr;
-    int selectedIndex = -1;
+    steer_sim sim;
+    sim.init(agent_config(), world_data());
 
-    perlin_gen perlin(10000);
+    agent_config& agentConfig = sim.config();
+    world_data& world = sim.world();
+    const perlin_gen& perlin = sim.perlin();
+    const agent_store& agents = sim.agents();
 
-    const int AGENT_COUNT = 10;
+    // held by handle so spawns and despawns cant retarget the selection
+    agent_handle selected = INVALID_AGENT;
+    int agentCountInput = world.agentCount;
 
-    for (int i = 0; i < AGENT_COUNT; ++i) {
-        steer_agent ag;
-        ag.position.x = (f32)Random::get(-20, 20);
-        ag.position.y = (f32)Random::get(-11, 11);
-        ag.target.x = (f32)Random::get(-20, 20);
-        ag.target.y = (f32)Random::get(-11, 11);
-        ag.wanderAngle = Random::get(0.f, 360.f);
-        init_agent(ag, physicsWorld);
-        agents.push_back(ag);
-    }
+    // picking index, agents outside the region just sit in the root
+    quad_tree agentTree(aabb{ vec2(-64, -64), vec2(64, 64) }, 6);
+    std::vector<int> agentTreeHandles;
+    std::vector<int> pickResults;
 
     int fps = 0;
     u64 ticks = SDL_GetPerformanceCounter();
@@ -197,26 +143,34 @@ int main(int argc, char* argv[]) {
     f32 dt = 0.f;
     f32 time = 0.f;
 
+    // agents are drawn this far between their last two fixed ticks
+    f32 renderAlpha = 0.f;
+    int ticksThisFrame = 0;
+    f32 tickMs = 0.f;
+
     aabb baseRect{ vec2(-5, -5), vec2(5, 5) };
     aabb moveRect{ vec2(-1, -1), vec2(1, 1) };
 
     bool isRunning = true;
     while (isRunning) {
-        if (selectedIndex >= 0) {
-            selected = &agents[selectedIndex];
-        }
-        else {
-            selected = nullptr;
-        }
+        int selectedIndex = agents.index_of(selected);
 
         int mdx = 0, mdy = 0, mdz = 0;
         int mx = 0, my = 0;
+        bool pickRequested = false;
+        bool goalRequested = false;
+        bool wallRequested = false;
 
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             ImGui_ImplSDL2_ProcessEvent(&event);
             switch (event.type) {
             case SDL_KEYDOWN:
+                // g puts the route goal under the cursor, b toggles a wall there
+                if (!io.WantCaptureKeyboard && event.key.repeat == 0) {
+                    goalRequested |= (event.key.keysym.scancode == SDL_SCANCODE_G);
+                    wallRequested |= (event.key.keysym.scancode == SDL_SCANCODE_B);
+                }
                 if (event.key.keysym.scancode != SDL_SCANCODE_ESCAPE) {
                     break;
                 }
@@ -226,6 +180,11 @@ int main(int argc, char* argv[]) {
             case SDL_MOUSEWHEEL:
                 mdz = event.wheel.y;
                 break;
+            case SDL_MOUSEBUTTONDOWN:
+                if (event.button.button == SDL_BUTTON_LEFT && !io.WantCaptureMouse) {
+                    pickRequested = true;
+                }
+                break;
             }
         }
 
@@ -281,8 +240,9 @@ int main(int argc, char* argv[]) {
                     cam.move_relative(glm::vec3(0, 0, speed));
                 }
 
-                if (selected != nullptr) {
-                    cam.target = glm::vec3(selected->position.x, 0.f, selected->position.y);
+                if (selectedIndex >= 0) {
+                    vec2 followPos = agents.interpolated_position(selectedIndex, renderAlpha);
+                    cam.target = glm::vec3(followPos.x, 0.f, followPos.y);
                 }
 
                 if (input.get_key(SDL_SCANCODE_Q)) {
@@ -326,120 +286,67 @@ int main(int argc, char* argv[]) {
                 moveRect.move(moveRectAmount);
             }
 
-            for (auto& agent : agents) {
-                agent.position = agent.body->GetPosition();
-                agent.velocity = agent.body->GetLinearVelocity();
-
-                // TARGET
-                {
-                    auto wander = [&agentConfig, dt](steer_agent& agent) -> void {
-                        vec2 velocity = agent.velocity;
-                        if (agent.velocity == vec2::ZERO) {
-                            velocity = math::vec2_from_angle(Random::get(0.f, 360.f));
-                        }
-
-                        agent.future = agent.position + vec2::normalize(velocity) * agentConfig.wanderProjectionDist;
-
-                        agent.wanderTimer -= dt;
-                        if (agent.wanderTimer <= 0) {
-                            agent.wanderAngle += Random::get<f32>(-agentConfig.wanderAngleRange, agentConfig.wanderAngleRange);
-                            agent.wanderTimer += agentConfig.wanderInterval;
-                        }
-
-                        agent.target.x = agent.future.x + math::cos(agent.wanderAngle) * agentConfig.wanderProjectionRadius;
-                        agent.target.y = agent.future.y + math::sin(agent.wanderAngle) * agentConfig.wanderProjectionRadius;
-                    };
-
-                    vec2 velocity = agent.velocity;
-
-                    vec2 predicted = agent.position + vec2::normalize(agent.velocity) * 2.f;
+            if (goalRequested || wallRequested) {
+                glm::vec3 origin, dir;
+                cam.get_screen_ray(mousePoint, origin, dir);
+                vec2 ground = ray_ground_intersection(cam.position(), dir);
 
-                    vec2 pathDir;
-                    vec2 nearest = agentPath.nearest(predicted, pathDir);
-                    f32 pathDist = vec2::dist(nearest, agent.position);
+                if (goalRequested) {
+                    sim.set_goal(ground);
+                }
+                int cx, cy;
+                if (wallRequested && sim.nav().layout().world_to_cell(ground, cx, cy)) {
+                    sim.set_nav_cost(cx, cy, sim.nav().walkable(cx, cy) ? nav_grid::BLOCKED : nav_grid::OPEN);
+                }
+            }
 
-                    switch (agentConfig.seekMode) {
-                    case agent_seek_mode::kWander:
-                        wander(agent);
-                        break;
-                    case agent_seek_mode::kFollowPath:
-                        if (pathDist > agentConfig.pathFollowDist) {
-                            agent.target = nearest + pathDir * 1.f;
-                            agent.future = predicted;
-                        }
-                        else {
-                            wander(agent);
-                        }
-                        break;
-                    case agent_seek_mode::kReturn:
-                        agent.target = vec2::ZERO;
-                        break;
-                    }
+            // fixed rate sim, render rate is whatever the frame loop manages
+            {
+                u64 simStart = SDL_GetPerformanceCounter();
+                sim.set_focus(vec2(cam.target.x, cam.target.z), selected);
+                ticksThisFrame = sim.advance(dt);
+                if (ticksThisFrame > 0) {
+                    u64 simTicks = SDL_GetPerformanceCounter() - simStart;
+                    tickMs = (f32)((f64)simTicks * 1000.0 / (f64)SDL_GetPerformanceFrequency()) / ticksThisFrame;
                 }
+                renderAlpha = sim.interpolation_alpha();
+            }
 
-                // SEPARATE
-                const vec2 separation = [&agent, &agents, &agentConfig]() -> vec2 {
-                    vec2 sum = vec2::ZERO;
-                    int count = 0;
-                    for (auto& other : agents) {
-                        if (&other == &agent) {
-                            continue;
-                        }
+            // keep the picking index in step with what is drawn
+            while ((int)agentTreeHandles.size() > agents.size()) {
+                agentTree.remove(agentTreeHandles.back());
+                agentTreeHandles.pop_back();
+            }
+            for (int i = 0; i < agents.size(); ++i) {
+                aabb bounds = aabb::create_from_center(agents.interpolated_position(i, renderAlpha), vec2(0.5f, 0.5f));
+                if (i < (int)agentTreeHandles.size()) {
+                    agentTree.move(agentTreeHandles[i], bounds);
+                }
+                else {
+                    agentTreeHandles.push_back(agentTree.insert(bounds, i));
+                }
+            }
 
-                        vec2 delta = agent.position - other.position;
-                        f32 d = delta.len();
-                        if (d > 0 && d < agentConfig.separationDist) {
-                            sum += vec2::normalize(delta) / d;
-                            ++count;
-                        }
-                    }
+            if (pickRequested) {
+                glm::vec3 origin, dir;
+                cam.get_screen_ray(mousePoint, origin, dir);
+                vec2 ground = ray_ground_intersection(cam.position(), dir);
 
-                    if (count > 0) {
-                        sum /= count;
-                        sum.normalize();
-                        sum *= agentConfig.maxSpeed;
-                        return sum;
+                pickResults.clear();
+                agentTree.query_radius(ground, 0.5f, pickResults);
+
+                selected = INVALID_AGENT;
+                selectedIndex = -1;
+                f32 best = std::numeric_limits<f32>::max();
+                for (int i : pickResults) {
+                    f32 d = vec2::dist(agents.interpolated_position(i, renderAlpha), ground);
+                    if (d < best) {
+                        best = d;
+                        selectedIndex = i;
+                        selected = agents.handle_at(i);
                     }
-                    else {
-                        return vec2::ZERO;
-                    }
-                }();
-
-                // SEEK
-                [&agent, &agentPath, &perlin, &world, &separation, &agentConfig, dt] {
-                    vec2 targetDir;
-                    f32 targetDist;
-
-                    vec2 targetDelta = agent.target - agent.position;
-
-                    targetDelta.decompose(targetDir, targetDist);
-
-                    vec2 desired;
-                    const f32 BORDER_SIZE = 128.f;
-
-                    vec2 flow = flow_field::perlin_get(perlin, agent.position.x / world.flowDivisor, agent.position.y / world.flowDivisor, world.flowDepth);
-                    vec2 movement = targetDir * math::clamp01(targetDist / 40);
-
-                    desired = flow + movement;
-
-                    desired = agentConfig.movementScalar * movement + agentConfig.flowScalar * flow + agentConfig.separationScalar * separation;
-                    desired.normalize();
-                    desired *= agentConfig.maxSpeed;
-
-                    vec2 steer = desired - agent.velocity;
-                    steer.limit(agentConfig.maxAccel);
-
-                    agent.body->ApplyForce(steer, vec2::ZERO, true);
-                }();
-
-                // TICK MOVEMENT
-                [&agent, dt] {
-                    agent.rotation = math::angle_from_vec2(vec2::normalize(agent.velocity));
-                    agent.body->SetTransform(agent.position, agent.rotation);
-                }();
+                }
             }
-
-            physicsWorld.Step(dt, velocityIterations, positionIterations);
         }
 
         // UI
@@ -456,7 +363,9 @@ int main(int argc, char* argv[]) {
 
             ImGui::InputFloat3("position", &cam.target[0], 2);
 
-            ImGui::SliderInt("selected", &selectedIndex, -1, AGENT_COUNT - 1);
+            if (ImGui::SliderInt("selected", &selectedIndex, -1, agents.size() - 1)) {
+                selected = (selectedIndex >= 0) ? agents.handle_at(selectedIndex) : INVALID_AGENT;
+            }
 
             ImGui::End();
         }
@@ -485,13 +394,17 @@ int main(int argc, char* argv[]) {
             ImGui::InputFloat("Max Speed", &agentConfig.maxSpeed, 0.1f, 1.f, 2);
             ImGui::InputFloat("Max Acceleration", &agentConfig.maxAccel, 0.1f, 1.f, 2);
             ImGui::InputFloat("Separation Dist", &agentConfig.separationDist, 0.1f, 1.f, 2);
-            ImGui::InputFloat("Path Distance", &agentConfig.pathFollowDist, 0.1f, 1.f, 2);
+            ImGui::InputFloat("Flock Dist", &agentConfig.flockDist, 0.1f, 1.f, 2);
+            ImGui::InputFloat("Path Refind Dist", &agentConfig.pathRefindDist, 0.1f, 1.f, 2);
+            ImGui::InputFloat("Path Lookahead", &agentConfig.pathLookahead, 0.1f, 1.f, 2);
 
             ImGui::Separator();
 
             ImGui::SliderFloat("Movement Scalar", &agentConfig.movementScalar, 0.f, 1.f);
             ImGui::SliderFloat("Flow Scalar", &agentConfig.flowScalar, 0.f, 1.f);
             ImGui::SliderFloat("Separation Scalar", &agentConfig.separationScalar, 0.f, 1.f);
+            ImGui::SliderFloat("Alignment Scalar", &agentConfig.alignmentScalar, 0.f, 1.f);
+            ImGui::SliderFloat("Cohesion Scalar", &agentConfig.cohesionScalar, 0.f, 1.f);
 
             ImGui::Separator();
 
@@ -511,6 +424,64 @@ int main(int argc, char* argv[]) {
             ImGui::InputFloat("Flow Divisor", &world.flowDivisor, 0.1f, 1.f, 2);
             ImGui::InputFloat("Flow Depth", &world.flowDepth, 0.1f, 1.f, 2);
 
+            ImGui::Separator();
+
+            // spawns or despawns in place, the rest of the world keeps running
+            if (ImGui::InputInt("Agent Count", &agentCountInput, 10, 1000, ImGuiInputTextFlags_EnterReturnsTrue)) {
+                sim.set_agent_count(agentCountInput);
+                agentCountInput = world.agentCount;
+            }
+            if (ImGui::Button("x10")) {
+                sim.set_agent_count(agents.size() * 10);
+                agentCountInput = world.agentCount;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("/10")) {
+                sim.set_agent_count(agents.size() / 10);
+                agentCountInput = world.agentCount;
+            }
+
+            ImGui::Separator();
+
+            // integrator changes only take effect on restart
+            ImGui::Text("Integrator: ");
+            ImGui::SameLine();
+            if (ImGui::Button(integrator_mode_strs[(int)world.integrator])) {
+                world.integrator = (integrator_mode)(((int)world.integrator + 1) % (int)integrator_mode::kCount);
+            }
+            ImGui::SliderFloat("Agent Radius", &world.agentRadius, 0.05f, 1.f);
+            ImGui::SliderInt("Overlap Iterations", &world.overlapIterations, 0, 8);
+            ImGui::Checkbox("Hierarchical Routes", &world.hierarchicalRoutes);
+            // chunk size is picked up on restart
+            ImGui::SliderInt("Nav Chunk Size", &world.navChunkSize, 4, 64);
+            ImGui::Text("Route Planning: ");
+            ImGui::SameLine();
+            if (ImGui::Button(route_service_mode_strs[(int)world.routeServiceMode])) {
+                world.routeServiceMode = (route_service_mode)(((int)world.routeServiceMode + 1) % (int)route_service_mode::kCount);
+            }
+            ImGui::SliderFloat("Route Budget (us)", &world.routeBudgetUs, 50.f, 4000.f);
+            ImGui::Checkbox("Smooth Path", &world.smoothPath);
+            ImGui::SliderFloat("Path Spline Tolerance", &world.pathSplineTolerance, 0.001f, 0.5f);
+            if (ImGui::Button("Restart")) {
+                sim.init(agentConfig, world);
+                selected = INVALID_AGENT;
+                agentCountInput = world.agentCount;
+            }
+
+            ImGui::Separator();
+
+            ImGui::SliderInt("Tick Rate (Hz)", &world.tickRate, 10, 240);
+            ImGui::SliderInt("Max Ticks Per Frame", &world.maxTicksPerFrame, 1, 32);
+            ImGui::SliderFloat("Neighbor Skin", &world.neighborSkin, 0.f, 2.f);
+
+            ImGui::Separator();
+
+            ImGui::Checkbox("Steering LOD", &world.lodEnabled);
+            ImGui::SliderFloat("LOD Near Dist", &world.lodNearDist, 0.f, 200.f);
+            ImGui::SliderFloat("LOD Far Dist", &world.lodFarDist, world.lodNearDist, 400.f);
+            ImGui::SliderInt("LOD Mid Interval", &world.lodMidInterval, 1, 16);
+            ImGui::SliderInt("LOD Far Interval", &world.lodFarInterval, 1, 32);
+
             ImGui::End();
         }
         {
@@ -521,6 +492,9 @@ int main(int argc, char* argv[]) {
             ImGui::Checkbox("Separation Radius", &debugConfig.showSeparationRadius);
             ImGui::Checkbox("Path", &debugConfig.showPath);
             ImGui::Checkbox("Flow Field", &debugConfig.showFlowField);
+            ImGui::Checkbox("Quad Tree", &debugConfig.showQuadTree);
+            ImGui::Checkbox("LOD Buckets", &debugConfig.showLod);
+            ImGui::Checkbox("Nav Grid", &debugConfig.showNav);
 
             ImGui::End();
         }
@@ -528,6 +502,41 @@ int main(int argc, char* argv[]) {
             ImGui::Begin("Stats");
 
             ImGui::Text("FPS: %d", fps);
+            ImGui::Text("Sim Threads: %d", sim.thread_count());
+            ImGui::Text("Integrator: %s", integrator_mode_strs[(int)sim.active_integrator()]);
+            ImGui::Text("Ticks This Frame: %d (dropped %d)", ticksThisFrame, sim.dropped_ticks());
+            ImGui::Text("Tick Cost: %.3f ms", tickMs);
+            ImGui::Text("Render Alpha: %.2f", renderAlpha);
+            ImGui::Text("Path: %d segments, %d vertices removed", sim.agent_path().segment_count(), sim.path_vertices_removed());
+            ImGui::Text("LOD Near/Mid/Far: %d / %d / %d", sim.lod_count(0), sim.lod_count(1), sim.lod_count(2));
+            ImGui::Text("Steered Last Tick: %d", sim.steered_count());
+            {
+                const neighbor_list& lists = sim.neighbor_lists();
+                const f32 agentCount = math::max(1.f, (f32)agents.size());
+                ImGui::Text("Neighbor Rebuilds: %d / %llu ticks", lists.rebuild_count(), (unsigned long long)sim.tick_count());
+                ImGui::Text("Neighbor Lists: avg %.1f, max %d", lists.total_size() / agentCount, lists.max_size());
+            }
+            {
+                const grid_astar& planner = sim.route_planner();
+                ImGui::Text("Route Searches: %d, cache hits %d (%d cached)", planner.search_count(), planner.cache_hits(), planner.cache_size());
+                ImGui::Text("Last Search Expanded: %d", planner.last_expanded());
+                const route_service& queue = sim.route_queue();
+                ImGui::Text("Route Queue: %d waiting, %d done, %d over budget, last slice %.0f us",
+                    queue.queue_depth(), queue.completed(), queue.overruns(), queue.last_slice_us());
+                ImGui::Text("Route Latency: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms",
+                    queue.latency_percentile(0.5f), queue.latency_percentile(0.95f), queue.latency_percentile(0.99f));
+                // incremental repairs next to what solving from scratch took
+                const goal_field& field = sim.goal_flow();
+                ImGui::Text("Goal Field: %d solves, %d repairs", field.solve_count(), field.repair_count());
+                ImGui::Text("Goal Field Expanded: %d (full solve %d)", field.last_expanded(), field.full_expanded());
+                const dstar_lite& focus = sim.focus_planner();
+                ImGui::Text("Focus Route: %d solves, %d repairs", focus.solve_count(), focus.repair_count());
+                ImGui::Text("Focus Route Expanded: %d (full solve %d)", focus.last_expanded(), focus.full_expanded());
+                const hpa_planner& chunks = sim.chunk_planner();
+                ImGui::Text("Chunks: %d, %d entrance nodes, %d relinked last edit", chunks.chunk_count(), chunks.entrance_nodes(), chunks.chunks_rebuilt());
+                ImGui::Text("Chunk Routes: %d searches, %d hits, %d legs refined, last expanded %d",
+                    chunks.search_count(), chunks.cache_hits(), chunks.legs_refined(), chunks.last_expanded());
+            }
 
             glm::vec3 origin, dir;
             cam.get_screen_ray(mousePoint, origin, dir);
@@ -578,6 +587,8 @@ int main(int argc, char* argv[]) {
             //// debug path
             if (debugConfig.showPath) {
                 draw.set_color(1, 1, 0);
+                // init can replace the path, so dont hold on to it across frames
+                const path& agentPath = sim.agent_path();
                 for (int i = 0; i < agentPath.path_points().size(); ++i) {
                     vec2 pt1 = agentPath.path_points()[i];
                     vec2 pt2 = agentPath.path_points()[(i + 1) % agentPath.path_points().size()];
@@ -588,47 +599,139 @@ int main(int argc, char* argv[]) {
             // flow field
             if (debugConfig.showFlowField) {
                 draw.set_color_bytes(255, 0, 0);
+                // a column at a time through the batched noise
+                f32 sampleX[64], sampleY[64];
+                vec2 dirs[64];
                 for (f32 x = math::floor(cam.target.x - 20.f); x < math::ceil(cam.target.x + 20.f); x++) {
-                    for (f32 y = math::floor(cam.target.z - 20.f); y < math::ceil(cam.target.z + 20.f); y++) {
-                        vec2 dir = flow_field::perlin_get(perlin, x / world.flowDivisor, y / world.flowDivisor, world.flowDepth);
+                    int count = 0;
+                    for (f32 y = math::floor(cam.target.z - 20.f); y < math::ceil(cam.target.z + 20.f) && count < 64; y++) {
+                        sampleX[count] = x / world.flowDivisor;
+                        sampleY[count] = y / world.flowDivisor;
+                        ++count;
+                    }
+                    flow_field::perlin_get(perlin, sampleX, sampleY, world.flowDepth, dirs, count);
+                    f32 y = math::floor(cam.target.z - 20.f);
+                    for (int k = 0; k < count; ++k, y++) {
                         vec2 pos = vec2(x, y);
-                        draw.line(pos + dir * 0.5f, pos - dir * 0.5f);
+                        draw.line(pos + dirs[k] * 0.5f, pos - dirs[k] * 0.5f);
                     }
                 }
             }
 
-            for (const auto& agent : agents) {
+            // walls near the camera, the goal and the selected agent's route
+            if (debugConfig.showNav) {
+                const nav_grid& nav = sim.nav();
+                const grid_layout& layout = nav.layout();
+                int minX, minY, maxX, maxY;
+                layout.world_to_cell(vec2(cam.target.x - 20.f, cam.target.z - 20.f), minX, minY);
+                layout.world_to_cell(vec2(cam.target.x + 20.f, cam.target.z + 20.f), maxX, maxY);
+
+                draw.set_color_bytes(160, 82, 45);
+                for (int cy = minY; cy <= maxY; ++cy) {
+                    for (int cx = minX; cx <= maxX; ++cx) {
+                        if (layout.contains(cx, cy) && !nav.walkable(cx, cy)) {
+                            aabb cell;
+                            cell.botLeft = layout.cell_to_world(cx, cy);
+                            cell.topRight = layout.cell_to_world(cx + 1, cy + 1);
+                            draw_aabb(draw, cell);
+                            draw.line(cell.botLeft, cell.topRight);
+                        }
+                    }
+                }
+
+                if (sim.has_goal()) {
+                    draw.set_color_bytes(255, 215, 0);
+                    draw.circle(sim.goal(), 0.75f);
+                }
+
+                // goal field arrows, only meaningful once goal field mode has solved for this goal
+                if (sim.has_goal() && agentConfig.seekMode == agent_seek_mode::kGoalField) {
+                    const flow_field& field = sim.goal_flow().directions();
+                    draw.set_color_bytes(210, 180, 60);
+                    for (int cy = minY; cy <= maxY; ++cy) {
+                        for (int cx = minX; cx <= maxX; ++cx) {
+                            vec2 dir = field.get(cx, cy);
+                            if (dir != vec2::ZERO) {
+                                vec2 middle = layout.cell_middle(cx, cy);
+                                draw.line(middle - dir * 0.35f, middle + dir * 0.35f);
+                                draw.circle(middle + dir * 0.35f, 0.05f);
+                            }
+                        }
+                    }
+                }
+
+                int routeIndex = agents.index_of(selected);
+                if (routeIndex >= 0 && agents.route[routeIndex] != nullptr) {
+                    draw.set_color_bytes(255, 215, 0);
+                    const std::vector<vec2>& pts = agents.route[routeIndex]->path_points();
+                    for (size_t i = 1; i < pts.size(); ++i) {
+                        draw.line(pts[i - 1], pts[i]);
+                    }
+                }
+            }
+
+            if (debugConfig.showQuadTree) {
+                draw.set_color_bytes(255, 165, 0);
+                for (const auto& q : agentTree.quads()) {
+                    if (q.depth >= 0) {
+                        draw_aabb(draw, q.bounds);
+                    }
+                }
+            }
+
+            // each pass only streams the columns it draws
+            const int agentCount = agents.size();
+            // the ui may have spawned or despawned since the frame started
+            selectedIndex = agents.index_of(selected);
+            for (int i = 0; i < agentCount; ++i) {
+                const vec2 position = agents.interpolated_position(i, renderAlpha);
+                const f32 rotation = agents.interpolated_rotation(i, renderAlpha);
                 vec2 points[3] = {
-                    .5f * math::vec2_from_angle(agent.rotation) + agent.position,
-                    .5f * math::vec2_from_angle(agent.rotation - 135) + agent.position,
-                    .5f * math::vec2_from_angle(agent.rotation + 135) + agent.position
+                    .5f * math::vec2_from_angle(rotation) + position,
+                    .5f * math::vec2_from_angle(rotation - 135) + position,
+                    .5f * math::vec2_from_angle(rotation + 135) + position
                 };
 
-                if (selected == &agent) {
+                if (i == selectedIndex) {
                     draw.set_color(0.8f, 1, 0.8f);
                 }
+                else if (debugConfig.showLod && agents.lodLevel[i] == 1) {
+                    draw.set_color(1, 1, 0);
+                }
+                else if (debugConfig.showLod && agents.lodLevel[i] == 2) {
+                    draw.set_color(1, 0.3f, 0);
+                }
                 else {
                     draw.set_color(0, 1, 0);
                 }
                 draw.lines(points, 3);
+            }
 
-                if (debugConfig.showWanderProjection) {
-                    draw.set_color_bytes(179, 120, 210);
-                    draw.line(agent.position, agent.future);
-                    draw.line(agent.future, agent.future + math::vec2_from_angle(agent.wanderAngle) * agentConfig.wanderProjectionRadius);
-                    draw.circle(agent.future, agentConfig.wanderProjectionRadius);
+            if (debugConfig.showWanderProjection) {
+                draw.set_color_bytes(179, 120, 210);
+                for (int i = 0; i < agentCount; ++i) {
+                    const vec2 future = agents.future(i);
+                    draw.line(agents.position(i), future);
+                    draw.line(future, future + math::vec2_from_angle(agents.wanderAngle[i]) * agentConfig.wanderProjectionRadius);
+                    draw.circle(future, agentConfig.wanderProjectionRadius);
                 }
+            }
 
-                if (debugConfig.showTarget) {
-                    draw.set_color_bytes(31, 255, 31);
-                    draw.line(agent.position, agent.target);
+            if (debugConfig.showTarget) {
+                draw.set_color_bytes(31, 255, 31);
+                for (int i = 0; i < agentCount; ++i) {
+                    draw.line(agents.position(i), agents.target(i));
                 }
+            }
 
-                if (debugConfig.showSeparationRadius) {
-                    draw.set_color_bytes(100, 149, 247);
-                    draw.circle(agent.position, agentConfig.separationDist);
+            if (debugConfig.showSeparationRadius) {
+                draw.set_color_bytes(100, 149, 247);
+                for (int i = 0; i < agentCount; ++i) {
+                    draw.circle(agents.position(i), agentConfig.separationDist);
                 }
+            }
 
+            {
                 glm::vec3 origin, dir;
                 cam.get_screen_ray(mousePoint, origin, dir);
 
@@ -666,6 +769,196 @@ int main(int argc, char* argv[]) {
     return 0;
 }
 
+int run_headless(int tickCount, bool ramp, integrator_mode integrator) {
+    world_data world;
+    world.integrator = integrator;
+
+    steer_sim sim;
+    sim.init(agent_config(), world);
+    const f32 dt = sim.fixed_dt();
+    const u64 frequency = SDL_GetPerformanceFrequency();
+
+    const int rampCounts[] = { 10, 100, 1000, 10000, 100000 };
+    const int stepCount = ramp ? (int)(sizeof(rampCounts) / sizeof(rampCounts[0])) : 1;
+
+    for (int step = 0; step < stepCount; ++step) {
+        if (ramp) {
+            sim.set_agent_count(rampCounts[step]);
+        }
+
+        u64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < tickCount; ++i) {
+            sim.tick(dt);
+        }
+        u64 elapsed = SDL_GetPerformanceCounter() - start;
+
+        f64 totalMs = (f64)elapsed * 1000.0 / (f64)frequency;
+        printf("%d agents, %d threads, %s, %d ticks: %.3f ms total, %.4f ms/tick\n",
+            sim.agents().size(), sim.thread_count(), integrator_mode_strs[(int)integrator], tickCount, totalMs, totalMs / math::max(1.f, (f32)tickCount));
+    }
+
+    return 0;
+}
+
+int verify_noise() {
+    const perlin_gen perlin(10000);
+    const int samples = 1 << 16;
+    // negative, far out and exactly on lattice points all take their own floor and wrap paths
+    std::default_random_engine engine(1);
+    std::uniform_real_distribution<f32> near(-4.f, 4.f);
+    std::uniform_real_distribution<f32> far(-70000.f, 70000.f);
+    std::uniform_int_distribution<int> lattice(-300, 300);
+
+    int mismatches = 0;
+    for (int s = 0; s < samples; s += 8) {
+        f32 x[8], y[8], z[8];
+        for (int i = 0; i < 8; ++i) {
+            switch ((s / 8 + i) % 3) {
+            case 0:
+                x[i] = near(engine);
+                y[i] = near(engine);
+                z[i] = near(engine);
+                break;
+            case 1:
+                x[i] = far(engine);
+                y[i] = far(engine);
+                z[i] = near(engine);
+                break;
+            default:
+                x[i] = (f32)lattice(engine);
+                y[i] = (f32)lattice(engine) + 0.5f;
+                z[i] = 0.f;
+                break;
+            }
+        }
+
+        f32 wide[8], narrow[8];
+        perlin.noise8(x, y, z, wide);
+        perlin.noise4(x, y, z, narrow);
+        perlin.noise4(x + 4, y + 4, z + 4, narrow + 4);
+        for (int i = 0; i < 8; ++i) {
+            f32 expected = perlin.noise(x[i], y[i], z[i]);
+            mismatches += (std::memcmp(&wide[i], &expected, sizeof(f32)) != 0) ? 1 : 0;
+            mismatches += (std::memcmp(&narrow[i], &expected, sizeof(f32)) != 0) ? 1 : 0;
+        }
+    }
+
+    printf("batched noise, %d lanes: %d of %d samples differ from noise\n", perlin_gen::simd_width(), mismatches, samples * 2);
+    return (mismatches == 0) ? 0 : 1;
+}
+
+int verify_worker_routes() {
+    // each round walls off another column but for a gap at the top, then asks across it the way the
+    // sim does after an edit, cancel then resubmit. the worker gets a head start before the first
+    // update, so a request planned on its old copy of the grid would walk through the new wall.
+    // updates then run until the ticket comes back, only a worker stuck for seconds fails on time
+    const int size = 64;
+    const u32 timeoutMs = 10000;
+    const grid_layout layout((f32)size, (f32)size, 1.f, 0.f, 0.f);
+    nav_grid grid(layout);
+    route_service service(grid, 16);
+    service.set_mode(route_service_mode::kWorker);
+
+    std::vector<route_result> finished;
+    int delivered = 0;
+    int bad = 0;
+    const int rounds = 20;
+    for (int round = 0; round < rounds; ++round) {
+        for (int y = 0; y < size - 1; ++y) {
+            grid.set_cost(10 + round * 2, y, nav_grid::BLOCKED);
+        }
+        service.cancel_all();
+        const route_ticket ticket = service.submit(1, layout.cell_middle(2, size / 2), layout.cell_middle(size - 2, size / 2));
+        SDL_Delay(10);
+
+        const route_result* result = nullptr;
+        finished.clear();
+        for (u32 waited = 0; waited < timeoutMs; ++waited) {
+            service.update(1000.f, finished);
+            for (const route_result& r : finished) {
+                if (r.ticket == ticket) {
+                    result = &r;
+                }
+            }
+            if (result != nullptr) {
+                break;
+            }
+            SDL_Delay(1);
+        }
+        if (result == nullptr) {
+            continue;
+        }
+
+        ++delivered;
+        // there's always the gap, so no route is as wrong as one through a wall
+        if (result->route == nullptr) {
+            ++bad;
+            continue;
+        }
+        for (f32 s = 0.f; s <= result->route->length(); s += 0.1f) {
+            int cx, cy;
+            if (layout.world_to_cell(result->route->point_at(s), cx, cy) && !grid.walkable(cx, cy)) {
+                ++bad;
+                break;
+            }
+        }
+    }
+
+    printf("route worker: %d of %d rounds delivered, %d missing or through a wall\n", delivered, rounds, bad);
+    return (bad == 0 && delivered == rounds) ? 0 : 1;
+}
+
+int verify_kinematics() {
+    // the steering pass is split across threads and lod staggers who steers when, none of which may
+    // change the result, so every thread count has to land on the same bits as one thread. the
+    // overlap relaxation should also leave no two agents much closer than touching
+    const int agentCount = 2000;
+    const int tickCount = 300;
+    int failures = 0;
+    for (int m = (int)integrator_mode::kEuler; m < (int)integrator_mode::kCount; ++m) {
+        world_data world;
+        world.integrator = (integrator_mode)m;
+        world.agentCount = agentCount;
+        world.threadCount = 4;
+        world_data serialWorld = world;
+        serialWorld.threadCount = 1;
+
+        steer_sim sim;
+        steer_sim serial;
+        sim.init(agent_config(), world);
+        serial.init(agent_config(), serialWorld);
+        for (int t = 0; t < tickCount; ++t) {
+            sim.tick(sim.fixed_dt());
+            serial.tick(serial.fixed_dt());
+        }
+
+        const agent_store& agents = sim.agents();
+        const agent_store& reference = serial.agents();
+        int diverged = 0;
+        for (int i = 0; i < agents.size(); ++i) {
+            if (agents.posX[i] != reference.posX[i] || agents.posY[i] != reference.posY[i]) {
+                ++diverged;
+            }
+        }
+
+        const f32 minDist = 1.6f * world.agentRadius;
+        int overlaps = 0;
+        for (int i = 0; i < agents.size(); ++i) {
+            for (int j = i + 1; j < agents.size(); ++j) {
+                if (vec2::dist(agents.position(i), agents.position(j)) < minDist) {
+                    ++overlaps;
+                }
+            }
+        }
+
+        printf("%s: %d of %d agents differ from one thread, %d pairs closer than %.2f\n",
+            integrator_mode_strs[m], diverged, agents.size(), overlaps, minDist);
+        failures += (diverged == 0 && overlaps == 0) ? 0 : 1;
+    }
+
+    return (failures == 0) ? 0 : 1;
+}
+
 vec2 ray_ground_intersection(const glm::vec3& origin, const glm::vec3& direction) {
     f32 denom = glm::dot(direction, glm::vec3(0, 1, 0));
     if (denom < -1e-6) {
@@ -0,0 +1,52 @@
+#include "nav_grid.h"
+
+const grid_step GRID_STEPS[GRID_STEP_COUNT] = {
+    { 1, 0, 1.f }, { -1, 0, 1.f }, { 0, 1, 1.f }, { 0, -1, 1.f },
+    { 1, 1, 1.41421356f }, { -1, 1, 1.41421356f }, { 1, -1, 1.41421356f }, { -1, -1, 1.41421356f },
+};
+
+const u8 nav_grid::BLOCKED;
+const u8 nav_grid::OPEN;
+const int nav_grid::MAX_CHANGE_LOG;
+
+nav_grid::nav_grid(const grid_layout& layout)
+    : grid(layout)
+{
+    costs.assign(grid.cell_count(), OPEN);
+}
+
+void nav_grid::set_cost(int cx, int cy, u8 cost) {
+    int i = grid.index(cx, cy);
+    if (i < 0 || costs[i] == cost) {
+        return;
+    }
+
+    costs[i] = cost;
+    ++changes;
+
+    if ((int)changeLog.size() >= MAX_CHANGE_LOG) {
+        const int drop = MAX_CHANGE_LOG / 2;
+        changeLog.erase(changeLog.begin(), changeLog.begin() + drop);
+        logBase += drop;
+    }
+    changeLog.push_back(i);
+}
+
+void nav_grid::fill(u8 cost) {
+    costs.assign(grid.cell_count(), cost);
+    ++changes;
+
+    // every cell changed, no log covers that
+    changeLog.clear();
+    logBase = changes;
+}
+
+bool nav_grid::changes_since(u32 since, const int*& cells, int& count) const {
+    if (since < logBase || since > changes) {
+        return false;
+    }
+
+    cells = changeLog.data() + (since - logBase);
+    count = (int)(changes - since);
+    return true;
+}
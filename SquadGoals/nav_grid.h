@@ -0,0 +1,75 @@
+#pragma once
+
+#include "flowfield.h"
+#include <vector>
+
+// walkability and traversal cost per cell, laid over the world the same way as a flow field.
+// cost 0 blocks a cell, anything else multiplies the distance walked through it. the version
+// bumps on every change so planners can tell their cached answers have gone stale, and a log of
+// recently changed cells lets incremental planners repair just the part of the grid that moved.
+
+// the 8 moves, orthogonals first, length is before the entered cell's cost multiplies it
+struct grid_step {
+    int dx;
+    int dy;
+    f32 length;
+};
+
+const int GRID_STEP_COUNT = 8;
+extern const grid_step GRID_STEPS[GRID_STEP_COUNT];
+
+class nav_grid {
+public:
+    static const u8 BLOCKED = 0;
+    static const u8 OPEN = 1;
+
+    nav_grid() = default;
+    nav_grid(const grid_layout& layout);
+
+    // out of range cells are ignored
+    void set_cost(int cx, int cy, u8 cost);
+    void fill(u8 cost);
+
+    // out of range cells read as blocked
+    inline u8 cost(int cx, int cy) const {
+        int i = grid.index(cx, cy);
+        return (i >= 0) ? costs[i] : BLOCKED;
+    }
+    inline u8 cost(int index) const { return costs[index]; }
+    inline bool walkable(int cx, int cy) const { return cost(cx, cy) != BLOCKED; }
+    // true if move k out of the cell is allowed, a diagonal needs both cells it squeezes between open.
+    // symmetric, so it also says whether the neighbour can step back in
+    inline bool can_step(int cx, int cy, int k) const {
+        const int nx = cx + GRID_STEPS[k].dx;
+        const int ny = cy + GRID_STEPS[k].dy;
+        return walkable(nx, ny) && (k < 4 || (walkable(nx, cy) && walkable(cx, ny)));
+    }
+    // octile distance, the cheapest any walk between two cells can be since every cost is at least 1
+    static inline f32 octile(int dx, int dy) {
+        dx = (dx < 0) ? -dx : dx;
+        dy = (dy < 0) ? -dy : dy;
+        int diag = (dx < dy) ? dx : dy;
+        return (f32)(dx + dy) + (GRID_STEPS[4].length - 2.f) * (f32)diag;
+    }
+
+    inline const grid_layout& layout() const { return grid; }
+    inline int width() const { return grid.cellWidth; }
+    inline int height() const { return grid.cellHeight; }
+    inline u32 version() const { return changes; }
+
+    // cells changed after version, oldest first and possibly repeated. false if the log no longer
+    // reaches back that far or the whole grid was refilled since, the caller has to start over
+    bool changes_since(u32 since, const int*& cells, int& count) const;
+
+    // oldest entries are dropped past this, anyone that far behind re-solves from scratch
+    static const int MAX_CHANGE_LOG = 1 << 14;
+
+private:
+    grid_layout grid;
+    std::vector<u8> costs;
+    u32 changes = 0;
+
+    // changeLog[k] changed at version logBase + k + 1
+    std::vector<int> changeLog;
+    u32 logBase = 0;
+};
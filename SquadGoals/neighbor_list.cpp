@@ -0,0 +1,72 @@
+#include "neighbor_list.h"
+#include "job_system.h"
+
+bool neighbor_list::needs_rebuild(const f32* xs, const f32* ys, int count, f32 radius, f32 skin) const {
+    if (!valid || count != (int)anchorX.size() || radius != builtRadius || skin != builtSkin) {
+        return true;
+    }
+
+    const f32 limit2 = 0.25f * skin * skin;
+    for (int i = 0; i < count; ++i) {
+        f32 dx = xs[i] - anchorX[i];
+        f32 dy = ys[i] - anchorY[i];
+        if (dx * dx + dy * dy > limit2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void neighbor_list::rebuild(const f32* xs, const f32* ys, int count, f32 radius, f32 skin, job_system& jobs) {
+    const f32 reach = radius + skin;
+    const f32 reach2 = reach * reach;
+
+    grid.rebuild(xs, ys, count, reach);
+
+    anchorX.assign(xs, xs + count);
+    anchorY.assign(ys, ys + count);
+    offsets.assign(count + 1, 0);
+
+    // count pass, offsets[i + 1] holds agent i's list size
+    jobs.parallel_for(0, count, 512, [this, xs, ys, reach2](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const vec2 p(xs[i], ys[i]);
+            int n = 0;
+            grid.for_each_nearby(p, [xs, ys, &p, reach2, i, &n](int j) {
+                f32 dx = xs[j] - p.x;
+                f32 dy = ys[j] - p.y;
+                if (j != i && dx * dx + dy * dy < reach2) {
+                    ++n;
+                }
+            });
+            offsets[i + 1] = n;
+        }
+    });
+
+    maxSize = 0;
+    for (int i = 0; i < count; ++i) {
+        maxSize = (offsets[i + 1] > maxSize) ? offsets[i + 1] : maxSize;
+        offsets[i + 1] += offsets[i];
+    }
+    indices.resize(offsets[count]);
+
+    // fill pass, same walk so every list lands in hash order and matches a serial build
+    jobs.parallel_for(0, count, 512, [this, xs, ys, reach2](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const vec2 p(xs[i], ys[i]);
+            int* out = indices.data() + offsets[i];
+            grid.for_each_nearby(p, [xs, ys, &p, reach2, i, &out](int j) {
+                f32 dx = xs[j] - p.x;
+                f32 dy = ys[j] - p.y;
+                if (j != i && dx * dx + dy * dy < reach2) {
+                    *out++ = j;
+                }
+            });
+        }
+    });
+
+    builtRadius = radius;
+    builtSkin = skin;
+    valid = true;
+    ++rebuilds;
+}
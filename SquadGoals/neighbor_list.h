@@ -0,0 +1,54 @@
+#pragma once
+
+#include "spatial_hash.h"
+#include <vector>
+
+class job_system;
+
+// cached per agent neighbor lists
+// every list holds everyone within radius + skin at build time, so as long as nobody has moved
+// more than half the skin since, anyone now within radius is guaranteed to be in it. callers
+// still do their own distance test, the lists are a superset.
+
+class neighbor_list {
+public:
+    // true if the lists no longer cover radius for the given positions
+    bool needs_rebuild(const f32* xs, const f32* ys, int count, f32 radius, f32 skin) const;
+
+    void rebuild(const f32* xs, const f32* ys, int count, f32 radius, f32 skin, job_system& jobs);
+
+    // forces the next needs_rebuild to pass, dense indices change on spawn and despawn
+    inline void invalidate() { valid = false; }
+
+    // calls visit(index) for every neighbor cached for agent i
+    template <typename F>
+    void for_each(int i, F&& visit) const;
+
+    inline int size(int i) const { return offsets[i + 1] - offsets[i]; }
+    inline int total_size() const { return (int)indices.size(); }
+    inline int max_size() const { return maxSize; }
+    inline int rebuild_count() const { return rebuilds; }
+
+private:
+    bool valid = false;
+    f32 builtRadius = 0.f;
+    f32 builtSkin = 0.f;
+
+    // positions at the last build
+    std::vector<f32> anchorX, anchorY;
+
+    // offsets[i]..offsets[i + 1] is agent i's range in indices
+    std::vector<int> offsets;
+    std::vector<int> indices;
+
+    spatial_hash grid;
+    int maxSize = 0;
+    int rebuilds = 0;
+};
+
+template <typename F>
+void neighbor_list::for_each(int i, F&& visit) const {
+    for (int k = offsets[i]; k < offsets[i + 1]; ++k) {
+        visit(indices[k]);
+    }
+}
@@ -1,52 +1,490 @@
 #include "path.h"
+#include "cpu_features.h"
 
-path::path(path_dir dir, std::initializer_list<vec2> pts)
-    : dir(dir)
+#include <algorithm>
+
+// sse2 is part of every x64 target and the msvc x86 default
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PATH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+path::path(path_dir dir, std::initializer_list<vec2> pts, bool closed)
+    : dir(dir),
+    closed(closed)
 {
     this->points.insert(this->points.end(), pts.begin(), pts.end());
+    build_segments();
+    build_bvh();
 }
 
-path::path(path_dir dir, const vec2* pts, size_t count)
-    : dir(dir)
+path::path(path_dir dir, const vec2* pts, size_t count, bool closed)
+    : dir(dir),
+    closed(closed)
 {
     this->points.insert(this->points.end(), pts, pts + count);
+    build_segments();
+    build_bvh();
 }
 
+void path::build_segments() {
+    const int pointCount = (int)points.size();
+    const int count = closed ? pointCount : (pointCount > 1 ? pointCount - 1 : 0);
+    segX.resize(count);
+    segY.resize(count);
+    dirX.resize(count);
+    dirY.resize(count);
+    segLen.resize(count);
+    arcStart.resize(count);
 
-vec2 path::nearest(const vec2& p, vec2& direction) {
-    vec2 ret;
-    f32 shortest = std::numeric_limits<f32>::max();
-
-    for (int i = 0; i < points.size(); ++i) {
+    totalLength = 0.f;
+    // segments are numbered in travel order so arc length increases along the path direction
+    for (int i = 0; i < count; ++i) {
         int i0 = i;
-        int i1 = (i + 1) % points.size();
+        int i1 = (i + 1) % pointCount;
 
         if (dir == path_dir::kCCW) {
-            std::swap(i0, i1);
+            // an open path runs backwards from its last point, a loop from its first
+            i0 = closed ? (pointCount - i) % pointCount : pointCount - 1 - i;
+            i1 = i0 - 1 + (i0 == 0 ? pointCount : 0);
         }
 
         const vec2& pt0 = points[i0];
         const vec2& pt1 = points[i1];
-        vec2 a = p - pt0;
-        vec2 b = pt1 - pt0;
+        f32 len = (pt1 - pt0).len();
+        f32 inv = (len > 0.f) ? 1.f / len : 0.f;
+
+        segX[i] = pt0.x;
+        segY[i] = pt0.y;
+        dirX[i] = (pt1.x - pt0.x) * inv;
+        dirY[i] = (pt1.y - pt0.y) * inv;
+        segLen[i] = len;
+        arcStart[i] = totalLength;
+        totalLength += len;
+    }
+}
+
+vec2 path::scan(const vec2& p, vec2& direction, int& segment) const {
+    const int count = segment_count();
+
+    // branch free select so the loop vectorizes, the point is only rebuilt for the winner
+    f32 shortest = std::numeric_limits<f32>::max();
+    int best = 0;
+    for (int i = 0; i < count; ++i) {
+        f32 d2 = segment_dist2(i, p);
+
+        bool closer = d2 < shortest;
+        shortest = closer ? d2 : shortest;
+        best = closer ? i : best;
+    }
+
+    if (count == 0) {
+        segment = -1;
+        direction = vec2::ZERO;
+        return p;
+    }
+
+    segment = best;
+    return segment_point(best, p, direction);
+}
+
+void path::build_bvh() {
+    bvhNodes.clear();
+    bvhSegments.clear();
+
+    const int count = segment_count();
+    if (count < BVH_MIN_SEGMENTS) {
+        return;
+    }
+
+    bvhSegments.resize(count);
+    for (int i = 0; i < count; ++i) {
+        bvhSegments[i] = i;
+    }
+    bvhNodes.reserve(2 * count / BVH_LEAF_SIZE + 1);
+    bvhNodes.push_back(bvh_node());
+    build_bvh_node(0, 0, count);
+
+    bvhExtent = 0.f;
+    for (const vec2& pt : points) {
+        bvhExtent = math::max(bvhExtent, math::max(math::abs(pt.x), math::abs(pt.y)));
+    }
+}
+
+void path::build_bvh_node(int index, int begin, int end) {
+    bvh_node node;
+    node.minX = node.minY = std::numeric_limits<f32>::max();
+    node.maxX = node.maxY = -std::numeric_limits<f32>::max();
+    f32 cMinX = node.minX, cMinY = node.minY, cMaxX = node.maxX, cMaxY = node.maxY;
+
+    for (int k = begin; k < end; ++k) {
+        int i = bvhSegments[k];
+        f32 x1 = segX[i] + dirX[i] * segLen[i];
+        f32 y1 = segY[i] + dirY[i] * segLen[i];
+        node.minX = math::min(node.minX, math::min(segX[i], x1));
+        node.minY = math::min(node.minY, math::min(segY[i], y1));
+        node.maxX = math::max(node.maxX, math::max(segX[i], x1));
+        node.maxY = math::max(node.maxY, math::max(segY[i], y1));
+
+        f32 cx = (segX[i] + x1) * 0.5f;
+        f32 cy = (segY[i] + y1) * 0.5f;
+        cMinX = math::min(cMinX, cx);
+        cMinY = math::min(cMinY, cy);
+        cMaxX = math::max(cMaxX, cx);
+        cMaxY = math::max(cMaxY, cy);
+    }
+
+    if (end - begin <= BVH_LEAF_SIZE) {
+        node.first = begin;
+        node.count = end - begin;
+        bvhNodes[index] = node;
+        return;
+    }
+
+    // median split along the wider spread of segment centers
+    const bool splitX = (cMaxX - cMinX) >= (cMaxY - cMinY);
+    const int mid = (begin + end) / 2;
+    std::nth_element(bvhSegments.begin() + begin, bvhSegments.begin() + mid, bvhSegments.begin() + end,
+        [this, splitX](int a, int b) {
+            f32 ca = splitX ? (2.f * segX[a] + dirX[a] * segLen[a]) : (2.f * segY[a] + dirY[a] * segLen[a]);
+            f32 cb = splitX ? (2.f * segX[b] + dirX[b] * segLen[b]) : (2.f * segY[b] + dirY[b] * segLen[b]);
+            return (ca < cb) || (ca == cb && a < b);
+        });
+
+    // children sit in consecutive slots so the parent only needs the first
+    node.first = (int)bvhNodes.size();
+    node.count = 0;
+    bvhNodes[index] = node;
+    bvhNodes.push_back(bvh_node());
+    bvhNodes.push_back(bvh_node());
+
+    build_bvh_node(node.first, begin, mid);
+    build_bvh_node(node.first + 1, mid, end);
+}
+
+static inline f32 box_dist2(f32 minX, f32 minY, f32 maxX, f32 maxY, const vec2& p) {
+    f32 ex = math::max(math::max(minX - p.x, p.x - maxX), 0.f);
+    f32 ey = math::max(math::max(minY - p.y, p.y - maxY), 0.f);
+    return ex * ex + ey * ey;
+}
+
+vec2 path::bvh_search(const vec2& p, vec2& direction, int& segment) const {
+    f32 shortest = std::numeric_limits<f32>::max();
+    int best = -1;
+
+    // box distances are exact but segment distances carry rounding error that grows with the
+    // coordinates, pad the prune test by that much so a segment that ties in float math is never
+    // skipped just because its box looked a hair further away
+    const f32 reach = bvhExtent + math::max(math::abs(p.x), math::abs(p.y));
+    const f32 slack = 32.f * std::numeric_limits<f32>::epsilon() * reach * reach;
+
+    // a node is pushed with its box distance so it can be dropped if the best improves meanwhile
+    int stack[64];
+    f32 stackDist[64];
+    int top = 0;
+    stack[top] = 0;
+    stackDist[top++] = 0.f;
+
+    while (top > 0) {
+        --top;
+        // only skip boxes strictly further than the best, an equal one could still hold a lower index tie
+        if (stackDist[top] > shortest + slack) {
+            continue;
+        }
+
+        const bvh_node& node = bvhNodes[stack[top]];
+        if (node.count > 0) {
+            for (int k = node.first; k < node.first + node.count; ++k) {
+                int i = bvhSegments[k];
+                f32 d2 = segment_dist2(i, p);
+                // ties go to the lowest index, which is what the linear scan keeps
+                if (d2 < shortest || (d2 == shortest && i < best)) {
+                    shortest = d2;
+                    best = i;
+                }
+            }
+        }
+        else {
+            const bvh_node& a = bvhNodes[node.first];
+            const bvh_node& b = bvhNodes[node.first + 1];
+            f32 da = box_dist2(a.minX, a.minY, a.maxX, a.maxY, p);
+            f32 db = box_dist2(b.minX, b.minY, b.maxX, b.maxY, p);
+
+            // push the nearer child last so it is searched first and tightens the bound early
+            int first = node.first;
+            if (da < db) {
+                stack[top] = first + 1;
+                stackDist[top++] = db;
+                stack[top] = first;
+                stackDist[top++] = da;
+            }
+            else {
+                stack[top] = first;
+                stackDist[top++] = da;
+                stack[top] = first + 1;
+                stackDist[top++] = db;
+            }
+        }
+    }
+
+    segment = best;
+    return segment_point(best, p, direction);
+}
+
+vec2 path::nearest(const vec2& p, vec2& direction) const {
+    int segment;
+    return search(p, direction, segment);
+}
+
+vec2 path::nearest(const vec2& p, vec2& direction, path_cursor& cursor, f32 refindDist) const {
+    const int count = segment_count();
+    if (count == 0) {
+        direction = vec2::ZERO;
+        return p;
+    }
+
+    if (cursor.segment >= 0 && cursor.segment < count) {
+        f32 shortest = std::numeric_limits<f32>::max();
+        int best = cursor.segment;
+
+        // the loop wraps, so the window does too and must not see a segment twice, an open path's
+        // window just stops at the ends
+        const int window = (!closed || CURSOR_WINDOW * 2 + 1 < count) ? CURSOR_WINDOW : (count - 1) / 2;
+        for (int k = -window; k <= window; ++k) {
+            int i = cursor.segment + k;
+            if (!closed && (i < 0 || i >= count)) {
+                continue;
+            }
+            i = (i % count + count) % count;
+
+            f32 d2 = segment_dist2(i, p);
+            if (d2 < shortest) {
+                shortest = d2;
+                best = i;
+            }
+        }
+
+        if (shortest <= refindDist * refindDist) {
+            cursor.segment = best;
+            return segment_point(best, p, direction);
+        }
+    }
+
+    // lost track, pay for the full scan once and pick the cursor back up from there
+    return search(p, direction, cursor.segment);
+}
 
-        b.normalize();
-        vec2 pathPt = pt0 + b * a.dot(b);
+f32 path::wrap(f32 s) const {
+    if (totalLength <= 0.f) {
+        return 0.f;
+    }
+    if (!closed) {
+        return math::clamp(s, 0.f, totalLength);
+    }
+    s -= math::floor(s / totalLength) * totalLength;
+    // rounding can land exactly on the length
+    return (s < totalLength) ? s : 0.f;
+}
 
-        pathPt = vec2::on_segment_or_other(pathPt, pt0, pt1, pt1);
+int path::segment_at(f32 s, int hint) const {
+    const int count = segment_count();
 
-        f32 d = vec2::dist(pathPt, p);
-        if (d < shortest) {
-            shortest = d;
-            ret = pathPt;
-            direction = (pt1 - pt0).normalize();
+    // short forward walk from the hint, an agent's lookahead rarely crosses more than a segment or two
+    if (hint >= 0 && hint < count && arcStart[hint] <= s) {
+        for (int step = 0; step < 4; ++step) {
+            if (s < arcStart[hint] + segLen[hint] || hint == count - 1) {
+                return hint;
+            }
+            ++hint;
         }
     }
 
-    return ret;
+    // last segment starting at or before s, equal starts mean zero length segments so the last one wins
+    int i = (int)(std::upper_bound(arcStart.begin(), arcStart.end(), s) - arcStart.begin()) - 1;
+    return (i > 0) ? i : 0;
+}
+
+f32 path::arc_on_segment(int i, const vec2& pointOnSegment) const {
+    f32 t = (pointOnSegment.x - segX[i]) * dirX[i] + (pointOnSegment.y - segY[i]) * dirY[i];
+    return arcStart[i] + math::clamp(t, 0.f, segLen[i]);
+}
+
+vec2 path::point_at(f32 s, int hint) const {
+    if (segment_count() == 0) {
+        return vec2::ZERO;
+    }
+
+    s = wrap(s);
+    int i = segment_at(s, hint);
+    f32 t = math::clamp(s - arcStart[i], 0.f, segLen[i]);
+    return vec2(segX[i] + dirX[i] * t, segY[i] + dirY[i] * t);
+}
+
+vec2 path::tangent_at(f32 s, int hint) const {
+    if (segment_count() == 0) {
+        return vec2::ZERO;
+    }
+
+    int i = segment_at(wrap(s), hint);
+    return vec2(dirX[i], dirY[i]);
+}
+
+f32 path::project(const vec2& p, vec2* nearestOut) const {
+    if (segment_count() == 0) {
+        return 0.f;
+    }
+
+    vec2 direction;
+    int segment;
+    vec2 pt = search(p, direction, segment);
+    if (nearestOut != nullptr) {
+        *nearestOut = pt;
+    }
+    return arc_on_segment(segment, pt);
+}
+
+f32 path::project(const vec2& p, path_cursor& cursor, f32 refindDist, vec2* nearestOut) const {
+    if (segment_count() == 0) {
+        return 0.f;
+    }
+
+    vec2 direction;
+    vec2 pt = nearest(p, direction, cursor, refindDist);
+    if (nearestOut != nullptr) {
+        *nearestOut = pt;
+    }
+    return arc_on_segment(cursor.segment, pt);
+}
+
+#ifdef SIMD_X86
+// eight query points per segment test, the sse2 scan below at twice the width. picks the segment
+// of each lane into best
+SIMD_TARGET("avx2")
+static void nearest8_avx2(const f32* segX, const f32* segY, const f32* dirX, const f32* dirY, const f32* segLen, int count,
+    const f32* xs, const f32* ys, int* best) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 px = _mm256_loadu_ps(xs);
+    const __m256 py = _mm256_loadu_ps(ys);
+    __m256 shortest = _mm256_set1_ps(std::numeric_limits<f32>::max());
+    __m256i bestLane = _mm256_setzero_si256();
+
+    for (int i = 0; i < count; ++i) {
+        __m256 ux = _mm256_set1_ps(dirX[i]);
+        __m256 uy = _mm256_set1_ps(dirY[i]);
+        __m256 dx = _mm256_sub_ps(px, _mm256_set1_ps(segX[i]));
+        __m256 dy = _mm256_sub_ps(py, _mm256_set1_ps(segY[i]));
+        __m256 t = _mm256_add_ps(_mm256_mul_ps(dx, ux), _mm256_mul_ps(dy, uy));
+        t = _mm256_max_ps(zero, _mm256_min_ps(t, _mm256_set1_ps(segLen[i])));
+        __m256 ex = _mm256_sub_ps(dx, _mm256_mul_ps(ux, t));
+        __m256 ey = _mm256_sub_ps(dy, _mm256_mul_ps(uy, t));
+        __m256 d2 = _mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey));
+
+        __m256 closer = _mm256_cmp_ps(d2, shortest, _CMP_LT_OQ);
+        shortest = _mm256_blendv_ps(shortest, d2, closer);
+        bestLane = _mm256_blendv_epi8(bestLane, _mm256_set1_epi32(i), _mm256_castps_si256(closer));
+    }
+
+    _mm256_storeu_si256((__m256i*)best, bestLane);
+}
+#endif
+
+void path::nearest_batch(const path_batch_query& query, int begin, int end) const {
+    const int count = segment_count();
+
+    auto write = [this, &query](int q, int segment) {
+        const vec2 p(query.xs[q], query.ys[q]);
+        vec2 direction = vec2::ZERO;
+        vec2 pt = p;
+        if (segment >= 0) {
+            pt = segment_point(segment, p, direction);
+        }
+
+        if (query.nearestX != nullptr) {
+            query.nearestX[q] = pt.x;
+        }
+        if (query.nearestY != nullptr) {
+            query.nearestY[q] = pt.y;
+        }
+        if (query.dirX != nullptr) {
+            query.dirX[q] = direction.x;
+        }
+        if (query.dirY != nullptr) {
+            query.dirY[q] = direction.y;
+        }
+        if (query.dist != nullptr) {
+            query.dist[q] = vec2::dist(pt, p);
+        }
+        if (query.segment != nullptr) {
+            query.segment[q] = segment;
+        }
+    };
+
+    if (count == 0) {
+        for (int q = begin; q < end; ++q) {
+            write(q, -1);
+        }
+        return;
+    }
+
+    int q = begin;
+
+#ifdef SIMD_X86
+    if (cpu_has_avx2()) {
+        for (; q + 8 <= end; q += 8) {
+            int lanes[8];
+            nearest8_avx2(segX.data(), segY.data(), dirX.data(), dirY.data(), segLen.data(), count, query.xs + q, query.ys + q, lanes);
+            for (int lane = 0; lane < 8; ++lane) {
+                write(q + lane, lanes[lane]);
+            }
+        }
+    }
+#endif
+
+#ifdef PATH_SSE2
+    // four query points per segment test, same operations in the same order as segment_dist2 and
+    // a strict less than per lane, so every lane lands on exactly the segment the scalar scan would
+    const __m128 zero = _mm_setzero_ps();
+    for (; q + 4 <= end; q += 4) {
+        const __m128 px = _mm_loadu_ps(query.xs + q);
+        const __m128 py = _mm_loadu_ps(query.ys + q);
+        __m128 shortest = _mm_set1_ps(std::numeric_limits<f32>::max());
+        __m128i best = _mm_setzero_si128();
+
+        for (int i = 0; i < count; ++i) {
+            __m128 ux = _mm_set1_ps(dirX[i]);
+            __m128 uy = _mm_set1_ps(dirY[i]);
+            __m128 dx = _mm_sub_ps(px, _mm_set1_ps(segX[i]));
+            __m128 dy = _mm_sub_ps(py, _mm_set1_ps(segY[i]));
+            __m128 t = _mm_add_ps(_mm_mul_ps(dx, ux), _mm_mul_ps(dy, uy));
+            t = _mm_max_ps(zero, _mm_min_ps(t, _mm_set1_ps(segLen[i])));
+            __m128 ex = _mm_sub_ps(dx, _mm_mul_ps(ux, t));
+            __m128 ey = _mm_sub_ps(dy, _mm_mul_ps(uy, t));
+            __m128 d2 = _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey));
+
+            __m128 closer = _mm_cmplt_ps(d2, shortest);
+            shortest = _mm_or_ps(_mm_and_ps(closer, d2), _mm_andnot_ps(closer, shortest));
+            __m128i closerMask = _mm_castps_si128(closer);
+            best = _mm_or_si128(_mm_and_si128(closerMask, _mm_set1_epi32(i)), _mm_andnot_si128(closerMask, best));
+        }
+
+        alignas(16) int lanes[4];
+        _mm_store_si128((__m128i*)lanes, best);
+        for (int lane = 0; lane < 4; ++lane) {
+            write(q + lane, lanes[lane]);
+        }
+    }
+#endif
+
+    // scalar tail, or everything without sse2
+    for (; q < end; ++q) {
+        vec2 direction;
+        int segment;
+        scan(vec2(query.xs[q], query.ys[q]), direction, segment);
+        write(q, segment);
+    }
 }
 
-f32 path::distance(const vec2& p) {
+f32 path::distance(const vec2& p) const {
     vec2 _;
     return (p - nearest(p, _)).len();
 }
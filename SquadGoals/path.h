@@ -9,19 +9,131 @@ enum class path_dir {
     kCCW
 };
 
+// remembers which segment a query last landed on so the next one only searches around it
+struct path_cursor {
+    int segment = -1;
+};
+
+// structure of arrays view for batched nearest queries, any output pointer may be null
+struct path_batch_query {
+    const f32* xs = nullptr;
+    const f32* ys = nullptr;
+    int count = 0;
+
+    f32* nearestX = nullptr;
+    f32* nearestY = nullptr;
+    f32* dirX = nullptr;
+    f32* dirY = nullptr;
+    f32* dist = nullptr;
+    int* segment = nullptr;
+};
+
+// polyline, closed into a loop unless built open
+// segment i runs from points[i] to points[i + 1], or backwards from points[-i] to points[-i - 1]
+// for kCCW, so segments always follow the travel direction. an open path has one segment fewer
+// and its arc length stops at the ends instead of wrapping. they are stored pre-digested
+// in flat arrays at construction, so queries are plain dot/clamp loops. nothing mutates after
+// construction so one path can be queried from any number of threads.
+
 class path {
 public:
-    path(path_dir dir, std::initializer_list<vec2> pts);
-    path(path_dir dir, const vec2* pts, size_t count);
+    path(path_dir dir, std::initializer_list<vec2> pts, bool closed = true);
+    path(path_dir dir, const vec2* pts, size_t count, bool closed = true);
 
     // find nearest point on path to point p
-    vec2 nearest(const vec2& p, vec2& direction);
+    vec2 nearest(const vec2& p, vec2& direction) const;
+    // same, but only searches a few segments either side of the cursor, falling back to every
+    // segment when the cursor is unset or the local best is further than refindDist
+    vec2 nearest(const vec2& p, vec2& direction, path_cursor& cursor, f32 refindDist) const;
     // how far away is p from the path
-    f32 distance(const vec2& p);
+    f32 distance(const vec2& p) const;
+
+    // nearest for queries [begin, end) of the batch, tested several points per segment at once.
+    // matches nearest exactly, and disjoint ranges can run on different threads
+    void nearest_batch(const path_batch_query& query, int begin, int end) const;
+    inline void nearest_batch(const path_batch_query& query) const { nearest_batch(query, 0, query.count); }
+
+    // arc length queries, s is measured from the start of segment 0 along the path direction and
+    // wraps around the loop. hint is a segment at or shortly before s, such as a cursor's, which
+    // turns the lookup into a short walk instead of a binary search
+    vec2 point_at(f32 s, int hint = -1) const;
+    vec2 tangent_at(f32 s, int hint = -1) const;
+    // arc length of the nearest point to p
+    f32 project(const vec2& p, vec2* nearestOut = nullptr) const;
+    f32 project(const vec2& p, path_cursor& cursor, f32 refindDist, vec2* nearestOut = nullptr) const;
+    // wraps s into [0, length), or clamps it to [0, length] on an open path
+    f32 wrap(f32 s) const;
 
     inline const std::vector<vec2>& path_points() const { return points; }
+    inline int segment_count() const { return (int)segLen.size(); }
+    inline f32 length() const { return totalLength; }
+    inline bool is_closed() const { return closed; }
+
+    inline bool has_bvh() const { return !bvhNodes.empty(); }
+
+    // segments either side of the cursor that a cursor query checks
+    static const int CURSOR_WINDOW = 2;
+    // paths with at least this many segments get a bvh, below it the flat scan wins
+    static const int BVH_MIN_SEGMENTS = 64;
+    static const int BVH_LEAF_SIZE = 4;
 
 private:
+    struct bvh_node {
+        f32 minX, minY, maxX, maxY;
+        // leaves hold bvhSegments[first, first + count), inner nodes have count 0 and their
+        // children at first and first + 1
+        int first;
+        int count;
+    };
+
+    void build_segments();
+    // segment containing wrapped arc length s
+    int segment_at(f32 s, int hint) const;
+    f32 arc_on_segment(int i, const vec2& pointOnSegment) const;
+    void build_bvh();
+    void build_bvh_node(int index, int begin, int end);
+
+    // squared distance from p to segment i
+    inline f32 segment_dist2(int i, const vec2& p) const;
+    // nearest point on segment i and its direction
+    inline vec2 segment_point(int i, const vec2& p, vec2& direction) const;
+    // nearest over every segment, also reporting which one won
+    vec2 scan(const vec2& p, vec2& direction, int& segment) const;
+    // same answer as scan, ties included, through the bvh
+    vec2 bvh_search(const vec2& p, vec2& direction, int& segment) const;
+    inline vec2 search(const vec2& p, vec2& direction, int& segment) const {
+        return has_bvh() ? bvh_search(p, direction, segment) : scan(p, direction, segment);
+    }
+
     std::vector<vec2> points;
     path_dir dir;
-};
\ No newline at end of file
+    bool closed;
+
+    // per segment start, unit direction (0 for degenerate segments), length and arc length from the
+    // start of segment 0 to the start of this one
+    std::vector<f32> segX, segY;
+    std::vector<f32> dirX, dirY;
+    std::vector<f32> segLen;
+    std::vector<f32> arcStart;
+    f32 totalLength = 0.f;
+
+    std::vector<bvh_node> bvhNodes;
+    std::vector<int> bvhSegments;
+    // largest absolute coordinate on the path, bounds the rounding error of segment distances
+    f32 bvhExtent = 0.f;
+};
+
+inline f32 path::segment_dist2(int i, const vec2& p) const {
+    f32 dx = p.x - segX[i];
+    f32 dy = p.y - segY[i];
+    f32 t = math::clamp(dx * dirX[i] + dy * dirY[i], 0.f, segLen[i]);
+    f32 ex = dx - dirX[i] * t;
+    f32 ey = dy - dirY[i] * t;
+    return ex * ex + ey * ey;
+}
+
+inline vec2 path::segment_point(int i, const vec2& p, vec2& direction) const {
+    f32 t = math::clamp((p.x - segX[i]) * dirX[i] + (p.y - segY[i]) * dirY[i], 0.f, segLen[i]);
+    direction = vec2(dirX[i], dirY[i]);
+    return vec2(segX[i] + dirX[i] * t, segY[i] + dirY[i] * t);
+}
\ No newline at end of file
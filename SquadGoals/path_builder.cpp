@@ -0,0 +1,229 @@
+#include "path_builder.h"
+
+// a closed loop needs at least a triangle and an open path a single segment, no stage takes
+// either below that
+static const int MIN_LOOP_VERTICES = 3;
+static const int MIN_OPEN_VERTICES = 2;
+
+static f32 segment_dist(const vec2& p, const vec2& a, const vec2& b) {
+    vec2 ab = b - a;
+    f32 len2 = ab.len2();
+    f32 t = (len2 > 0.f) ? math::clamp((p - a).dot(ab) / len2, 0.f, 1.f) : 0.f;
+    return vec2::dist(p, a + ab * t);
+}
+
+path_builder& path_builder::add(const vec2& pt) {
+    points.push_back(pt);
+    return *this;
+}
+
+path_builder& path_builder::add(const vec2* pts, size_t count) {
+    points.insert(points.end(), pts, pts + count);
+    return *this;
+}
+
+path_builder& path_builder::add_catmull_rom(const vec2* ctrl, size_t count, f32 tolerance) {
+    const int n = (int)count;
+    if (n < 2) {
+        return add(ctrl, count);
+    }
+
+    // each span p1 -> p2 of a uniform catmull-rom is the cubic bezier p1, p1 + (p2 - p0) / 6, p2 - (p3 - p1) / 6, p2
+    for (int i = 0; i < n; ++i) {
+        const vec2& p0 = ctrl[(i + n - 1) % n];
+        const vec2& p1 = ctrl[i];
+        const vec2& p2 = ctrl[(i + 1) % n];
+        const vec2& p3 = ctrl[(i + 2) % n];
+        flatten_cubic(p1, p1 + (p2 - p0) / 6.f, p2 - (p3 - p1) / 6.f, p2, tolerance, 0);
+    }
+    return *this;
+}
+
+path_builder& path_builder::add_bezier(const vec2* ctrl, size_t count, f32 tolerance) {
+    for (size_t i = 0; i + 3 < count; i += 3) {
+        flatten_cubic(ctrl[i], ctrl[i + 1], ctrl[i + 2], ctrl[i + 3], tolerance, 0);
+    }
+    // the chain's final end point, a loop that ends where it started gets welded away on build
+    if (count >= 4) {
+        points.push_back(ctrl[(count - 1) / 3 * 3]);
+    }
+    return *this;
+}
+
+void path_builder::flatten_cubic(const vec2& p0, const vec2& p1, const vec2& p2, const vec2& p3, f32 tolerance, int depth) {
+    // the curve stays inside the hull of its control points, so it never strays further from the
+    // chord than the inner control points do
+    f32 d1 = segment_dist(p1, p0, p3);
+    f32 d2 = segment_dist(p2, p0, p3);
+
+    if (depth >= MAX_FLATTEN_DEPTH || math::max(d1, d2) <= tolerance) {
+        points.push_back(p0);
+        return;
+    }
+
+    // de casteljau split at t = 0.5
+    vec2 p01 = (p0 + p1) * 0.5f;
+    vec2 p12 = (p1 + p2) * 0.5f;
+    vec2 p23 = (p2 + p3) * 0.5f;
+    vec2 p012 = (p01 + p12) * 0.5f;
+    vec2 p123 = (p12 + p23) * 0.5f;
+    vec2 mid = (p012 + p123) * 0.5f;
+
+    flatten_cubic(p0, p01, p012, mid, tolerance, depth + 1);
+    flatten_cubic(mid, p123, p23, p3, tolerance, depth + 1);
+}
+
+void path_builder::clear() {
+    points.clear();
+    welded = collinear = simplified = 0;
+}
+
+path path_builder::build(path_dir dir, bool closed) {
+    welded = collinear = simplified = 0;
+
+    weld(closed);
+    remove_collinear(closed);
+    if (simplifyTolerance > 0.f) {
+        simplify(closed);
+    }
+
+    return path(dir, points.data(), points.size(), closed);
+}
+
+void path_builder::weld(bool closed) {
+    const f32 weld2 = weldDist * weldDist;
+
+    std::vector<vec2> out;
+    out.reserve(points.size());
+    for (const vec2& pt : points) {
+        if (!out.empty() && (pt - out.back()).len2() <= weld2) {
+            continue;
+        }
+        out.push_back(pt);
+    }
+
+    // the loop closes back on the first vertex, so the last one can duplicate it too
+    while (closed && (int)out.size() > MIN_LOOP_VERTICES && (out.back() - out.front()).len2() <= weld2) {
+        out.pop_back();
+    }
+
+    welded = (int)(points.size() - out.size());
+    points.swap(out);
+}
+
+void path_builder::remove_collinear(bool closed) {
+    const int minVertices = closed ? MIN_LOOP_VERTICES : MIN_OPEN_VERTICES;
+
+    // drop b when a -> b -> c carries straight on, one pass can expose another so go until nothing changes.
+    // an open path's end points have only one neighbour and always stay
+    bool removed = true;
+    while (removed && (int)points.size() > minVertices) {
+        removed = false;
+
+        const int skip = closed ? 0 : 1;
+        for (int i = skip; i < (int)points.size() - skip && (int)points.size() > minVertices; ) {
+            const int count = (int)points.size();
+            const vec2& a = points[(i + count - 1) % count];
+            const vec2& b = points[i];
+            const vec2& c = points[(i + 1) % count];
+
+            vec2 ab = b - a;
+            vec2 bc = c - b;
+            f32 cross = ab.x * bc.y - ab.y * bc.x;
+            f32 scale = ab.len() * bc.len();
+
+            // parallel and heading the same way, a vertex where the loop doubles back is kept
+            if (math::abs(cross) <= 1e-6f * scale && ab.dot(bc) > 0.f) {
+                points.erase(points.begin() + i);
+                ++collinear;
+                removed = true;
+            }
+            else {
+                ++i;
+            }
+        }
+    }
+}
+
+void path_builder::simplify(bool closed) {
+    const int count = (int)points.size();
+    if (count <= (closed ? MIN_LOOP_VERTICES : MIN_OPEN_VERTICES)) {
+        return;
+    }
+
+    // an open chain is a single douglas-peucker run between its end points
+    if (!closed) {
+        std::vector<bool> keep(count, false);
+        keep[0] = keep[count - 1] = true;
+        simplify_range(points, 0, count - 1, keep);
+
+        std::vector<vec2> out;
+        for (int i = 0; i < count; ++i) {
+            if (keep[i]) {
+                out.push_back(points[i]);
+            }
+        }
+        simplified = count - (int)out.size();
+        points.swap(out);
+        return;
+    }
+
+    // split the loop at vertex 0 and the vertex furthest from it, then simplify each half as an open chain
+    int far = 0;
+    f32 farDist2 = 0.f;
+    for (int i = 1; i < count; ++i) {
+        f32 d2 = (points[i] - points[0]).len2();
+        if (d2 > farDist2) {
+            farDist2 = d2;
+            far = i;
+        }
+    }
+    if (far == 0) {
+        return;
+    }
+
+    std::vector<vec2> ring(points);
+    ring.push_back(points[0]);
+
+    std::vector<bool> keep(count + 1, false);
+    keep[0] = keep[far] = keep[count] = true;
+    simplify_range(ring, 0, far, keep);
+    simplify_range(ring, far, count, keep);
+
+    std::vector<vec2> out;
+    for (int i = 0; i < count; ++i) {
+        if (keep[i]) {
+            out.push_back(points[i]);
+        }
+    }
+
+    // too aggressive a tolerance can flatten the loop to a line, keep the original then
+    if ((int)out.size() < MIN_LOOP_VERTICES) {
+        return;
+    }
+
+    simplified = count - (int)out.size();
+    points.swap(out);
+}
+
+void path_builder::simplify_range(const std::vector<vec2>& ring, int first, int last, std::vector<bool>& keep) const {
+    if (last - first < 2) {
+        return;
+    }
+
+    int worst = -1;
+    f32 worstDist = simplifyTolerance;
+    for (int i = first + 1; i < last; ++i) {
+        f32 d = segment_dist(ring[i], ring[first], ring[last]);
+        if (d > worstDist) {
+            worstDist = d;
+            worst = i;
+        }
+    }
+
+    if (worst >= 0) {
+        keep[worst] = true;
+        simplify_range(ring, first, worst, keep);
+        simplify_range(ring, worst, last, keep);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "path.h"
+#include <vector>
+
+// cleans up raw vertex soup before it becomes an immutable path
+// consecutive vertices closer than the weld distance merge, vertices lying on the line between
+// their neighbours drop out, and a non zero tolerance also runs douglas-peucker over the loop.
+// an open build keeps both end points and never wraps from the last vertex to the first.
+// the counters say how much each stage removed from the last build.
+// splines are flattened into vertices as they are added, so the path they build is an ordinary
+// polyline and queries cost the same as for hand placed points.
+
+class path_builder {
+public:
+    path_builder& add(const vec2& pt);
+    path_builder& add(const vec2* pts, size_t count);
+    // closed uniform catmull-rom loop through every control point
+    path_builder& add_catmull_rom(const vec2* ctrl, size_t count, f32 tolerance);
+    // chain of cubic beziers sharing end points, p0 c0 c1 p1 c2 c3 p2 ..., count must be 3n + 1
+    path_builder& add_bezier(const vec2* ctrl, size_t count, f32 tolerance);
+    void clear();
+
+    inline path_builder& weld_dist(f32 dist) { weldDist = dist; return *this; }
+    // 0 disables simplification
+    inline path_builder& simplify_tolerance(f32 tolerance) { simplifyTolerance = tolerance; return *this; }
+
+    path build(path_dir dir, bool closed = true);
+
+    inline int welded_count() const { return welded; }
+    inline int collinear_count() const { return collinear; }
+    inline int simplified_count() const { return simplified; }
+    inline int removed_count() const { return welded + collinear + simplified; }
+    inline const std::vector<vec2>& vertices() const { return points; }
+
+    // subdivision depth limit, 2^16 pieces per curve is far below any sane tolerance
+    static const int MAX_FLATTEN_DEPTH = 16;
+
+private:
+    // appends the curve's vertices up to but not including p3, splitting until the control points
+    // lie within tolerance of the chord
+    void flatten_cubic(const vec2& p0, const vec2& p1, const vec2& p2, const vec2& p3, f32 tolerance, int depth);
+    void weld(bool closed);
+    void remove_collinear(bool closed);
+    void simplify(bool closed);
+    void simplify_range(const std::vector<vec2>& ring, int first, int last, std::vector<bool>& keep) const;
+
+    std::vector<vec2> points;
+
+    f32 weldDist = 0.001f;
+    f32 simplifyTolerance = 0.f;
+
+    int welded = 0;
+    int collinear = 0;
+    int simplified = 0;
+};
@@ -1,6 +1,7 @@
 #include "perlin.h"
 
 #include "algebra.h"
+#include "cpu_features.h"
 
 using math::lerp;
 using math::grad;
@@ -10,6 +11,7 @@ perlin_gen::perlin_gen(u32 seed) {
     std::default_random_engine engine(seed);
     std::shuffle(&d[0], &d[256], engine);
     std::copy(&d[0], &d[256], &d[256]);
+    std::copy(&d[0], &d[512], &perm[0]);
 }
 
 f32 perlin_gen::noise(f32 x, f32 y, f32 z /* = 0.f */) const {
@@ -54,4 +56,235 @@ f32 perlin_gen::noise(f32 x, f32 y, f32 z /* = 0.f */) const {
         w);
 
     return (ret + 1.f) / 2.f;
-}
\ No newline at end of file
+}
+
+#ifdef SIMD_X86
+
+// the kernels are compiled into every x86 build and picked at runtime, so one binary runs anywhere
+// and still uses avx2 where it can. they spell out noise's float ops in the same order so lanes
+// come out identical, fade is ((t * t) * t) * ((t * 6 - 15) * t + 10) and lerp is a + (b - a) * t
+
+SIMD_TARGET("sse4.1")
+static inline __m128 fade4(__m128 t) {
+    __m128 inner = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.f)), _mm_set1_ps(15.f)), t), _mm_set1_ps(10.f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+SIMD_TARGET("sse4.1")
+static inline __m128 lerp4(__m128 a, __m128 b, __m128 t) {
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+SIMD_TARGET("sse4.1")
+static inline __m128 grad4(__m128i hash, __m128 x, __m128 y, __m128 z) {
+    __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+    __m128 below8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+    __m128 below4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+    __m128 takeX = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+
+    __m128 u = _mm_blendv_ps(y, x, below8);
+    __m128 v = _mm_blendv_ps(_mm_blendv_ps(z, x, takeX), y, below4);
+
+    // bit 0 negates u and bit 1 negates v, moved up into the sign bit
+    __m128 uSign = _mm_castsi128_ps(_mm_slli_epi32(h, 31));
+    __m128 vSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(h, 1), 31));
+    return _mm_add_ps(_mm_xor_ps(u, uSign), _mm_xor_ps(v, vSign));
+}
+
+// sse has no gather, so pull each lane's entry out one at a time
+SIMD_TARGET("sse4.1")
+static inline __m128i lookup4(const i32* perm, __m128i idx) {
+    return _mm_setr_epi32(perm[_mm_extract_epi32(idx, 0)], perm[_mm_extract_epi32(idx, 1)],
+        perm[_mm_extract_epi32(idx, 2)], perm[_mm_extract_epi32(idx, 3)]);
+}
+
+SIMD_TARGET("sse4.1")
+static void noise4_sse41(const i32* perm, const f32* px, const f32* py, const f32* pz, f32* out) {
+    const __m128i mask = _mm_set1_epi32(255);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128 onef = _mm_set1_ps(1.f);
+
+    __m128 x = _mm_loadu_ps(px);
+    __m128 y = _mm_loadu_ps(py);
+    __m128 z = _mm_loadu_ps(pz);
+    __m128 fx = _mm_floor_ps(x);
+    __m128 fy = _mm_floor_ps(y);
+    __m128 fz = _mm_floor_ps(z);
+
+    __m128i X = _mm_and_si128(_mm_cvttps_epi32(fx), mask);
+    __m128i Y = _mm_and_si128(_mm_cvttps_epi32(fy), mask);
+    __m128i Z = _mm_and_si128(_mm_cvttps_epi32(fz), mask);
+
+    x = _mm_sub_ps(x, fx);
+    y = _mm_sub_ps(y, fy);
+    z = _mm_sub_ps(z, fz);
+
+    __m128 u = fade4(x), v = fade4(y), w = fade4(z);
+
+    __m128i A = _mm_add_epi32(lookup4(perm, X), Y);
+    __m128i AA = _mm_add_epi32(lookup4(perm, A), Z);
+    __m128i AB = _mm_add_epi32(lookup4(perm, _mm_add_epi32(A, one)), Z);
+    __m128i B = _mm_add_epi32(lookup4(perm, _mm_add_epi32(X, one)), Y);
+    __m128i BA = _mm_add_epi32(lookup4(perm, B), Z);
+    __m128i BB = _mm_add_epi32(lookup4(perm, _mm_add_epi32(B, one)), Z);
+
+    __m128 x1 = _mm_sub_ps(x, onef);
+    __m128 y1 = _mm_sub_ps(y, onef);
+    __m128 z1 = _mm_sub_ps(z, onef);
+
+    __m128 ret = lerp4(
+        lerp4(
+            lerp4(
+                grad4(lookup4(perm, AA), x, y, z),
+                grad4(lookup4(perm, BA), x1, y, z),
+                u),
+            lerp4(
+                grad4(lookup4(perm, AB), x, y1, z),
+                grad4(lookup4(perm, BB), x1, y1, z),
+                u),
+            v),
+        lerp4(
+            lerp4(
+                grad4(lookup4(perm, _mm_add_epi32(AA, one)), x, y, z1),
+                grad4(lookup4(perm, _mm_add_epi32(BA, one)), x1, y, z1),
+                u),
+            lerp4(
+                grad4(lookup4(perm, _mm_add_epi32(AB, one)), x, y1, z1),
+                grad4(lookup4(perm, _mm_add_epi32(BB, one)), x1, y1, z1),
+                u),
+            v),
+        w);
+
+    _mm_storeu_ps(out, _mm_div_ps(_mm_add_ps(ret, onef), _mm_set1_ps(2.f)));
+}
+
+SIMD_TARGET("avx2")
+static inline __m256 fade8(__m256 t) {
+    __m256 inner = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.f)), _mm256_set1_ps(15.f)), t), _mm256_set1_ps(10.f));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
+
+SIMD_TARGET("avx2")
+static inline __m256 lerp8(__m256 a, __m256 b, __m256 t) {
+    return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+
+SIMD_TARGET("avx2")
+static inline __m256 grad8(__m256i hash, __m256 x, __m256 y, __m256 z) {
+    __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+    __m256 below8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+    __m256 below4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+    __m256 takeX = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+
+    __m256 u = _mm256_blendv_ps(y, x, below8);
+    __m256 v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, takeX), y, below4);
+
+    __m256 uSign = _mm256_castsi256_ps(_mm256_slli_epi32(h, 31));
+    __m256 vSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_srli_epi32(h, 1), 31));
+    return _mm256_add_ps(_mm256_xor_ps(u, uSign), _mm256_xor_ps(v, vSign));
+}
+
+SIMD_TARGET("avx2")
+static inline __m256i lookup8(const i32* perm, __m256i idx) {
+    return _mm256_i32gather_epi32((const int*)perm, idx, 4);
+}
+
+SIMD_TARGET("avx2")
+static void noise8_avx2(const i32* perm, const f32* px, const f32* py, const f32* pz, f32* out) {
+    const __m256i mask = _mm256_set1_epi32(255);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256 onef = _mm256_set1_ps(1.f);
+
+    __m256 x = _mm256_loadu_ps(px);
+    __m256 y = _mm256_loadu_ps(py);
+    __m256 z = _mm256_loadu_ps(pz);
+    __m256 fx = _mm256_floor_ps(x);
+    __m256 fy = _mm256_floor_ps(y);
+    __m256 fz = _mm256_floor_ps(z);
+
+    __m256i X = _mm256_and_si256(_mm256_cvttps_epi32(fx), mask);
+    __m256i Y = _mm256_and_si256(_mm256_cvttps_epi32(fy), mask);
+    __m256i Z = _mm256_and_si256(_mm256_cvttps_epi32(fz), mask);
+
+    x = _mm256_sub_ps(x, fx);
+    y = _mm256_sub_ps(y, fy);
+    z = _mm256_sub_ps(z, fz);
+
+    __m256 u = fade8(x), v = fade8(y), w = fade8(z);
+
+    __m256i A = _mm256_add_epi32(lookup8(perm, X), Y);
+    __m256i AA = _mm256_add_epi32(lookup8(perm, A), Z);
+    __m256i AB = _mm256_add_epi32(lookup8(perm, _mm256_add_epi32(A, one)), Z);
+    __m256i B = _mm256_add_epi32(lookup8(perm, _mm256_add_epi32(X, one)), Y);
+    __m256i BA = _mm256_add_epi32(lookup8(perm, B), Z);
+    __m256i BB = _mm256_add_epi32(lookup8(perm, _mm256_add_epi32(B, one)), Z);
+
+    __m256 x1 = _mm256_sub_ps(x, onef);
+    __m256 y1 = _mm256_sub_ps(y, onef);
+    __m256 z1 = _mm256_sub_ps(z, onef);
+
+    __m256 ret = lerp8(
+        lerp8(
+            lerp8(
+                grad8(lookup8(perm, AA), x, y, z),
+                grad8(lookup8(perm, BA), x1, y, z),
+                u),
+            lerp8(
+                grad8(lookup8(perm, AB), x, y1, z),
+                grad8(lookup8(perm, BB), x1, y1, z),
+                u),
+            v),
+        lerp8(
+            lerp8(
+                grad8(lookup8(perm, _mm256_add_epi32(AA, one)), x, y, z1),
+                grad8(lookup8(perm, _mm256_add_epi32(BA, one)), x1, y, z1),
+                u),
+            lerp8(
+                grad8(lookup8(perm, _mm256_add_epi32(AB, one)), x, y1, z1),
+                grad8(lookup8(perm, _mm256_add_epi32(BB, one)), x1, y1, z1),
+                u),
+            v),
+        w);
+
+    _mm256_storeu_ps(out, _mm256_div_ps(_mm256_add_ps(ret, onef), _mm256_set1_ps(2.f)));
+}
+
+#endif
+
+void perlin_gen::noise4(const f32* x, const f32* y, const f32* z, f32* out) const {
+#ifdef SIMD_X86
+    if (cpu_has_sse41()) {
+        noise4_sse41(perm, x, y, z, out);
+        return;
+    }
+#endif
+    for (int i = 0; i < 4; ++i) {
+        out[i] = noise(x[i], y[i], z[i]);
+    }
+}
+
+void perlin_gen::noise8(const f32* x, const f32* y, const f32* z, f32* out) const {
+#ifdef SIMD_X86
+    if (cpu_has_avx2()) {
+        noise8_avx2(perm, x, y, z, out);
+        return;
+    }
+#endif
+    noise4(x, y, z, out);
+    noise4(x + 4, y + 4, z + 4, out + 4);
+}
+
+void perlin_gen::noise(const f32* x, const f32* y, f32 z, f32* out, int count) const {
+    const f32 zs[8] = { z, z, z, z, z, z, z, z };
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        noise8(x + i, y + i, zs, out + i);
+    }
+    for (; i < count; ++i) {
+        out[i] = noise(x[i], y[i], z);
+    }
+}
+
+int perlin_gen::simd_width() {
+    return cpu_has_avx2() ? 8 : cpu_has_sse41() ? 4 : 1;
+}
@@ -12,6 +12,17 @@ class perlin_gen {
 public:
     perlin_gen(u32 seed);
     f32 noise(f32 x, f32 y, f32 z = 0.f) const;
+    // 4 or 8 points a call, sse4.1 and avx2 when the cpu has them, one point at a time otherwise.
+    // every lane matches noise bit for bit
+    void noise4(const f32* x, const f32* y, const f32* z, f32* out) const;
+    void noise8(const f32* x, const f32* y, const f32* z, f32* out) const;
+    // count points on the same z slice, eight at a time then one at a time
+    void noise(const f32* x, const f32* y, f32 z, f32* out, int count) const;
+
+    // lanes the widest batch path on this cpu runs, 1 when there's only the scalar fallback
+    static int simd_width();
 private:
     u8 d[512];
-};
\ No newline at end of file
+    // d widened so the avx2 path can gather straight out of it
+    i32 perm[512];
+};
@@ -0,0 +1,331 @@
+#include "quadtree.h"
+
+#include <algorithm>
+
+static inline bool overlaps(const aabb& a, const aabb& b) {
+    return a.left() <= b.right() && b.left() <= a.right() && a.bottom() <= b.top() && b.bottom() <= a.top();
+}
+
+static inline bool inside(const aabb& box, const vec2& pt) {
+    return pt.x >= box.left() && pt.x <= box.right() && pt.y >= box.bottom() && pt.y <= box.top();
+}
+
+static inline f32 distance2(const aabb& box, const vec2& pt) {
+    f32 dx = math::max(math::max(box.left() - pt.x, pt.x - box.right()), 0.f);
+    f32 dy = math::max(math::max(box.bottom() - pt.y, pt.y - box.top()), 0.f);
+    return dx * dx + dy * dy;
+}
+
+// slab test, tEnter is where the ray enters the box (0 if it starts inside)
+static bool ray_box(const vec2& origin, const vec2& dir, f32 maxDist, const aabb& box, f32& tEnter) {
+    f32 tMin = 0.f;
+    f32 tMax = maxDist;
+
+    const f32 o[2] = { origin.x, origin.y };
+    const f32 d[2] = { dir.x, dir.y };
+    const f32 lo[2] = { box.left(), box.bottom() };
+    const f32 hi[2] = { box.right(), box.top() };
+
+    for (int axis = 0; axis < 2; ++axis) {
+        if (d[axis] == 0.f) {
+            if (o[axis] < lo[axis] || o[axis] > hi[axis]) {
+                return false;
+            }
+            continue;
+        }
+
+        f32 inv = 1.f / d[axis];
+        f32 t0 = (lo[axis] - o[axis]) * inv;
+        f32 t1 = (hi[axis] - o[axis]) * inv;
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+
+        tMin = math::max(tMin, t0);
+        tMax = math::min(tMax, t1);
+        if (tMin > tMax) {
+            return false;
+        }
+    }
+
+    tEnter = tMin;
+    return true;
+}
+
+quad_tree::quad_tree(const aabb& region, int maxDepth)
+    : maxDepth((maxDepth < MAX_DEPTH) ? maxDepth : MAX_DEPTH)
+{
+    // keep the region square so every level splits evenly
+    vec2 dims = region.dimensions();
+    f32 side = math::max(dims.x, dims.y);
+    this->region = aabb{ region.botLeft, region.botLeft + vec2(side, side) };
+
+    clear();
+}
+
+aabb quad_tree::loose_bounds(const quad& q) {
+    vec2 half = q.bounds.dimensions() / 2;
+    return aabb{ q.bounds.botLeft - half, q.bounds.topRight + half };
+}
+
+void quad_tree::clear() {
+    nodes.clear();
+    items.clear();
+    freeNode = -1;
+    freeItem = -1;
+    liveItems = 0;
+
+    new_node(-1, region);
+}
+
+void quad_tree::rebuild(const aabb* bounds, int count) {
+    clear();
+    items.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        insert(bounds[i], i);
+    }
+}
+
+int quad_tree::insert(const aabb& bounds, int id) {
+    int handle;
+    if (freeItem >= 0) {
+        handle = freeItem;
+        freeItem = items[handle].next;
+    }
+    else {
+        handle = (int)items.size();
+        items.push_back(quad_item());
+    }
+
+    quad_item& item = items[handle];
+    item.bounds = bounds;
+    item.id = id;
+
+    link(handle, choose_node(bounds));
+    ++liveItems;
+
+    return handle;
+}
+
+void quad_tree::remove(int handle) {
+    int node = items[handle].node;
+    if (node < 0) {
+        return;
+    }
+
+    unlink(handle);
+    prune(node);
+
+    items[handle].next = freeItem;
+    freeItem = handle;
+    --liveItems;
+}
+
+void quad_tree::move(int handle, const aabb& bounds) {
+    items[handle].bounds = bounds;
+
+    int current = items[handle].node;
+    int target = choose_node(bounds);
+    if (target == current) {
+        return;
+    }
+
+    unlink(handle);
+    link(handle, target);
+    prune(current);
+}
+
+void quad_tree::query_aabb(const aabb& box, std::vector<int>& outIds) const {
+    int stack[MAX_DEPTH * 3 + 4];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const quad& q = nodes[stack[--top]];
+
+        for (int i = q.firstItem; i >= 0; i = items[i].next) {
+            if (overlaps(items[i].bounds, box)) {
+                outIds.push_back(items[i].id);
+            }
+        }
+
+        for (int c : q.children) {
+            if (c >= 0 && overlaps(loose_bounds(nodes[c]), box)) {
+                stack[top++] = c;
+            }
+        }
+    }
+}
+
+void quad_tree::query_radius(const vec2& center, f32 radius, std::vector<int>& outIds) const {
+    const f32 radius2 = radius * radius;
+
+    int stack[MAX_DEPTH * 3 + 4];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const quad& q = nodes[stack[--top]];
+
+        for (int i = q.firstItem; i >= 0; i = items[i].next) {
+            if (distance2(items[i].bounds, center) <= radius2) {
+                outIds.push_back(items[i].id);
+            }
+        }
+
+        for (int c : q.children) {
+            if (c >= 0 && distance2(loose_bounds(nodes[c]), center) <= radius2) {
+                stack[top++] = c;
+            }
+        }
+    }
+}
+
+bool quad_tree::raycast(const vec2& origin, const vec2& dir, f32 maxDist, int& outId, f32& outDist) const {
+    f32 best = maxDist;
+    bool hit = false;
+
+    int stack[MAX_DEPTH * 3 + 4];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const quad& q = nodes[stack[--top]];
+
+        f32 t;
+        for (int i = q.firstItem; i >= 0; i = items[i].next) {
+            if (ray_box(origin, dir, best, items[i].bounds, t) && (!hit || t < best)) {
+                best = t;
+                outId = items[i].id;
+                hit = true;
+            }
+        }
+
+        // only descend into nodes the ray reaches before the best hit so far
+        for (int c : q.children) {
+            if (c >= 0 && ray_box(origin, dir, best, loose_bounds(nodes[c]), t)) {
+                stack[top++] = c;
+            }
+        }
+    }
+
+    if (hit) {
+        outDist = best;
+    }
+    return hit;
+}
+
+int quad_tree::new_node(int parent, const aabb& bounds) {
+    int index;
+    if (freeNode >= 0) {
+        index = freeNode;
+        freeNode = nodes[index].parent;
+    }
+    else {
+        index = (int)nodes.size();
+        nodes.push_back(quad());
+    }
+
+    quad& q = nodes[index];
+    q.bounds = bounds;
+    q.children[0] = q.children[1] = q.children[2] = q.children[3] = -1;
+    q.parent = parent;
+    q.firstItem = -1;
+    q.itemCount = 0;
+    q.depth = (parent >= 0) ? nodes[parent].depth + 1 : 0;
+
+    return index;
+}
+
+int quad_tree::choose_node(const aabb& bounds) {
+    vec2 center = bounds.center();
+    vec2 half = bounds.dimensions() / 2;
+    f32 extent = math::max(half.x, half.y);
+
+    if (!inside(region, center)) {
+        return 0;
+    }
+
+    int node = 0;
+    while (nodes[node].depth < maxDepth) {
+        const aabb nodeBounds = nodes[node].bounds;
+        f32 childSize = (nodeBounds.right() - nodeBounds.left()) / 2;
+
+        // the child's loose bounds reach half a child past its edges
+        if (extent > childSize / 2) {
+            break;
+        }
+
+        vec2 mid = nodeBounds.center();
+        int quadrant = ((center.x >= mid.x) ? 1 : 0) + ((center.y >= mid.y) ? 2 : 0);
+
+        if (nodes[node].children[quadrant] < 0) {
+            vec2 childMin(
+                (quadrant & 1) ? mid.x : nodeBounds.left(),
+                (quadrant & 2) ? mid.y : nodeBounds.bottom());
+            int child = new_node(node, aabb{ childMin, childMin + vec2(childSize, childSize) });
+            nodes[node].children[quadrant] = child;
+        }
+
+        node = nodes[node].children[quadrant];
+    }
+
+    return node;
+}
+
+void quad_tree::link(int item, int node) {
+    quad_item& it = items[item];
+    quad& q = nodes[node];
+
+    it.node = node;
+    it.prev = -1;
+    it.next = q.firstItem;
+    if (q.firstItem >= 0) {
+        items[q.firstItem].prev = item;
+    }
+    q.firstItem = item;
+    ++q.itemCount;
+}
+
+void quad_tree::unlink(int item) {
+    quad_item& it = items[item];
+    quad& q = nodes[it.node];
+
+    if (it.prev >= 0) {
+        items[it.prev].next = it.next;
+    }
+    else {
+        q.firstItem = it.next;
+    }
+
+    if (it.next >= 0) {
+        items[it.next].prev = it.prev;
+    }
+
+    --q.itemCount;
+    it.node = -1;
+    it.prev = -1;
+    it.next = -1;
+}
+
+void quad_tree::prune(int node) {
+    // release empty leaves back up the tree, the root always stays
+    while (node > 0) {
+        quad& q = nodes[node];
+        if (q.itemCount > 0 || q.children[0] >= 0 || q.children[1] >= 0 || q.children[2] >= 0 || q.children[3] >= 0) {
+            return;
+        }
+
+        int parent = q.parent;
+        for (int& c : nodes[parent].children) {
+            if (c == node) {
+                c = -1;
+            }
+        }
+
+        q.parent = freeNode;
+        q.depth = -1;
+        freeNode = node;
+        node = parent;
+    }
+}
@@ -4,45 +4,74 @@
 
 #include <vector>
 
-//struct quad_node {
-//    int id = 0;
-//    vec2 point = vec2::ZERO;
-//    int childIds[4] = { -1, -1, -1, -1 };
-//};
-//
-//class quad_tree {
-//    std::vector<quad_node> nodes;
-//    
-//    void insert(const vec2& pt) {
-//        if (nodes.size() == 0) {
-//            nodes.push_back(quad_node{ 0, vec2::ZERO });
-//        }
-//
-//
-//    }
-//};
+// loose quadtree over a fixed square region
+// a node's loose bounds are twice its tight bounds, so an item only needs its center inside a
+// node and a half extent no larger than the node's half size to live there, which lets items
+// move without ever straddling a split. nodes and items live in flat arrays linked by index.
+// items whose center leaves the region are parked in the root, which queries always visit.
 
 struct quad {
     aabb bounds;
 
-    int topLeft;
-    int topRight;
-    int bottomLeft;
-    int bottomRight;
+    // bottom left, bottom right, top left, top right, -1 when absent
+    int children[4];
+    int parent;
+
+    int firstItem;
+    int itemCount;
+    // -1 while on the free list
+    int depth;
+};
+
+struct quad_item {
+    aabb bounds;
+    int id;
+
+    // owning node, -1 while on the free list
+    int node;
+    int prev;
+    int next;
 };
 
 class quad_tree {
-    quad_tree(f32 size) {
-        quads.push_back(quad { aabb(, -1, -1, -1, -1 });
+public:
+    quad_tree(const aabb& region, int maxDepth = 8);
 
+    void clear();
+    // clears and inserts bounds[i] with id i, handle i refers to item i afterwards
+    void rebuild(const aabb* bounds, int count);
 
-    }
+    // returns a handle that stays valid until the item is removed
+    int insert(const aabb& bounds, int id);
+    void remove(int handle);
+    // handle must be live
+    void move(int handle, const aabb& bounds);
 
-    void subdivide(quad* current, f32 minSize) {
-        if (current->)
-    }
+    void query_aabb(const aabb& box, std::vector<int>& outIds) const;
+    void query_radius(const vec2& center, f32 radius, std::vector<int>& outIds) const;
+    // nearest item whose bounds the ray enters within maxDist, dir must be normalized
+    bool raycast(const vec2& origin, const vec2& dir, f32 maxDist, int& outId, f32& outDist) const;
 
+    inline const std::vector<quad>& quads() const { return nodes; }
+    inline int item_count() const { return liveItems; }
 
-    std::vector<quad> quads;
-};
+    static aabb loose_bounds(const quad& q);
+
+private:
+    static const int MAX_DEPTH = 16;
+
+    int new_node(int parent, const aabb& bounds);
+    int choose_node(const aabb& bounds);
+    void link(int item, int node);
+    void unlink(int item);
+    void prune(int node);
 
+    std::vector<quad> nodes;
+    std::vector<quad_item> items;
+
+    aabb region;
+    int maxDepth;
+    int freeNode = -1;
+    int freeItem = -1;
+    int liveItems = 0;
+};
@@ -0,0 +1,212 @@
+#include "route_service.h"
+
+#include <algorithm>
+
+const char* route_service_mode_strs[(int)route_service_mode::kCount] {
+    "sliced",
+    "worker"
+};
+
+const int route_service::LATENCY_SAMPLES;
+const f32 route_service::SEARCH_ESTIMATE_RATE = 0.1f;
+
+route_service::route_service(const nav_grid& grid, int cacheCapacity)
+    : grid(grid),
+    planner(grid, cacheCapacity)
+{
+    latencies.reserve(LATENCY_SAMPLES);
+}
+
+route_service::~route_service() {
+    stop_worker();
+}
+
+void route_service::set_mode(route_service_mode mode) {
+    if (mode == serviceMode) {
+        return;
+    }
+
+    serviceMode = mode;
+    if (mode == route_service_mode::kWorker) {
+        start_worker();
+    }
+    else {
+        stop_worker();
+    }
+}
+
+void route_service::start_worker() {
+    // the worker plans on a copy so grid edits on the main thread never race a search
+    workerGrid = std::make_unique<nav_grid>(grid);
+    workerPlanner = std::make_unique<grid_astar>(*workerGrid);
+    postedVersion = grid.version();
+    quit = false;
+    worker = std::thread(&route_service::worker_main, this);
+}
+
+void route_service::stop_worker() {
+    if (!worker.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        quit = true;
+    }
+    wake.notify_all();
+    worker.join();
+
+    workerPlanner.reset();
+    workerGrid.reset();
+    pendingGrid.reset();
+}
+
+route_ticket route_service::submit(agent_handle agent, const vec2& start, const vec2& goal) {
+    route_ticket ticket = nextTicket++;
+    if (nextTicket == INVALID_TICKET) {
+        nextTicket = 1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        post_grid();
+        requests.push_back({ ticket, agent, start, goal, clock::now(), epoch });
+    }
+    if (serviceMode == route_service_mode::kWorker) {
+        wake.notify_one();
+    }
+    return ticket;
+}
+
+void route_service::cancel_all() {
+    // the grid goes over with the epoch bump, so the worker cant take a request of the new epoch
+    // and plan it on the old grid
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        requests.clear();
+        results.clear();
+        ++epoch;
+        post_grid();
+    }
+    if (serviceMode == route_service_mode::kWorker) {
+        wake.notify_one();
+    }
+}
+
+void route_service::post_grid() {
+    if (serviceMode != route_service_mode::kWorker || grid.version() == postedVersion) {
+        return;
+    }
+    pendingGrid = std::make_unique<nav_grid>(grid);
+    postedVersion = grid.version();
+}
+
+int route_service::queue_depth() const {
+    std::lock_guard<std::mutex> lk(lock);
+    return (int)requests.size();
+}
+
+void route_service::worker_main() {
+    std::unique_lock<std::mutex> lk(lock);
+    while (true) {
+        wake.wait(lk, [this]() { return quit || !requests.empty() || pendingGrid != nullptr; });
+        if (quit) {
+            return;
+        }
+
+        // same dimensions, so the planner's reference stays good and it sees the version move on
+        if (pendingGrid != nullptr) {
+            *workerGrid = *pendingGrid;
+            pendingGrid.reset();
+        }
+        if (requests.empty()) {
+            continue;
+        }
+
+        request req = requests.front();
+        requests.pop_front();
+        lk.unlock();
+
+        std::shared_ptr<const path> route = workerPlanner->find(req.start, req.goal);
+
+        lk.lock();
+        if (req.epoch == epoch) {
+            results.push_back({ { req.ticket, req.agent, route }, req.submitted, req.epoch });
+        }
+    }
+}
+
+void route_service::update(f32 budgetUs, std::vector<route_result>& finished) {
+    const clock::time_point sliceStart = clock::now();
+
+    if (serviceMode == route_service_mode::kWorker) {
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            post_grid();
+        }
+        wake.notify_one();
+        lastSliceUs = 0.f;
+    }
+    else {
+        // always run at least one so a tiny budget still makes progress, after that only start a
+        // search the running estimate says will fit
+        int ran = 0;
+        f32 elapsed = 0.f;
+        while (ran == 0 || elapsed + searchUs <= budgetUs) {
+            request req;
+            {
+                std::lock_guard<std::mutex> lk(lock);
+                if (requests.empty()) {
+                    break;
+                }
+                req = requests.front();
+                requests.pop_front();
+            }
+
+            const clock::time_point searchStart = clock::now();
+            std::shared_ptr<const path> route = planner.find(req.start, req.goal);
+            results.push_back({ { req.ticket, req.agent, route }, req.submitted, req.epoch });
+            ++ran;
+
+            const clock::time_point searchEnd = clock::now();
+            searchUs = math::lerp(searchUs, std::chrono::duration<f32, std::micro>(searchEnd - searchStart).count(), SEARCH_ESTIMATE_RATE);
+            elapsed = std::chrono::duration<f32, std::micro>(searchEnd - sliceStart).count();
+        }
+        lastSliceUs = elapsed;
+        overrunCount += (elapsed > budgetUs) ? 1 : 0;
+    }
+
+    const clock::time_point now = clock::now();
+    std::lock_guard<std::mutex> lk(lock);
+    for (const done& d : results) {
+        if (d.epoch != epoch) {
+            continue;
+        }
+        finished.push_back(d.result);
+        record_latency(d.submitted, now);
+        ++completedCount;
+    }
+    results.clear();
+}
+
+void route_service::record_latency(clock::time_point submitted, clock::time_point now) {
+    f32 ms = std::chrono::duration<f32, std::milli>(now - submitted).count();
+    if ((int)latencies.size() < LATENCY_SAMPLES) {
+        latencies.push_back(ms);
+    }
+    else {
+        latencies[latencyNext] = ms;
+    }
+    latencyNext = (latencyNext + 1) % LATENCY_SAMPLES;
+}
+
+f32 route_service::latency_percentile(f32 p) const {
+    if (latencies.empty()) {
+        return 0.f;
+    }
+
+    std::vector<f32> sorted(latencies);
+    int k = (int)(math::clamp01(p) * (f32)(sorted.size() - 1) + 0.5f);
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "nav_grid.h"
+#include "grid_astar.h"
+#include "agent_store.h"
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+
+// kSliced plans on the calling thread until the frame's budget is spent, kWorker hands planning
+// to a background thread working on its own copy of the grid
+enum class route_service_mode {
+    kSliced,
+    kWorker,
+    kCount,
+};
+
+extern const char* route_service_mode_strs[(int)route_service_mode::kCount];
+
+typedef u32 route_ticket;
+const route_ticket INVALID_TICKET = 0;
+
+struct route_result {
+    route_ticket ticket;
+    agent_handle agent;
+    // null when the goal cant be reached
+    std::shared_ptr<const path> route;
+};
+
+// queue of route requests that never plans more per frame than it is allowed to
+// requests go in with a ticket, finished routes come back out of update tagged with it. a search is
+// never split, a slice only starts one when the average search so far still fits, so a search much
+// slower than usual can still run a slice over its budget, those are counted.
+// latency runs from submit to the update that hands the result back.
+
+class route_service {
+public:
+    // the grid must outlive the service and keep its dimensions
+    route_service(const nav_grid& grid, int cacheCapacity = 256);
+    ~route_service();
+
+    route_service(const route_service&) = delete;
+    route_service& operator=(const route_service&) = delete;
+
+    // switching to kSliced waits for the worker's current request, queued ones carry over
+    void set_mode(route_service_mode mode);
+    route_ticket submit(agent_handle agent, const vec2& start, const vec2& goal);
+    // plans for up to budgetUs in sliced mode, or sends the worker the latest grid, then appends
+    // every result finished since the last call
+    void update(f32 budgetUs, std::vector<route_result>& finished);
+    // forgets queued requests and throws away anything in flight, for when goal or grid change.
+    // in worker mode this also sends the worker the current grid before anything new is queued
+    void cancel_all();
+
+    inline route_service_mode mode() const { return serviceMode; }
+    inline const grid_astar& sliced_planner() const { return planner; }
+    int queue_depth() const;
+    inline int completed() const { return completedCount; }
+    inline int overruns() const { return overrunCount; }
+    inline f32 last_slice_us() const { return lastSliceUs; }
+    // submit to delivery in milliseconds over the last LATENCY_SAMPLES results, p in [0, 1]
+    f32 latency_percentile(f32 p) const;
+
+    static const int LATENCY_SAMPLES = 512;
+    // how fast the per search time estimate follows new searches
+    static const f32 SEARCH_ESTIMATE_RATE;
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct request {
+        route_ticket ticket;
+        agent_handle agent;
+        vec2 start;
+        vec2 goal;
+        clock::time_point submitted;
+        u32 epoch;
+    };
+
+    struct done {
+        route_result result;
+        clock::time_point submitted;
+        u32 epoch;
+    };
+
+    void start_worker();
+    void stop_worker();
+    void worker_main();
+    // hands the worker a copy of the grid if it changed since the last one, lock must be held
+    void post_grid();
+    void record_latency(clock::time_point submitted, clock::time_point now);
+
+    const nav_grid& grid;
+    grid_astar planner;
+    route_service_mode serviceMode = route_service_mode::kSliced;
+    route_ticket nextTicket = 1;
+
+    // shared with the worker, everything below lock
+    mutable std::mutex lock;
+    std::condition_variable wake;
+    std::deque<request> requests;
+    std::vector<done> results;
+    // bumped by cancel_all, anything finished under an older epoch is dropped
+    u32 epoch = 0;
+    bool quit = false;
+    // set when the main thread has a newer grid for the worker
+    std::unique_ptr<nav_grid> pendingGrid;
+
+    // the worker's own grid and planner, only touched by the worker thread once it runs
+    std::unique_ptr<nav_grid> workerGrid;
+    std::unique_ptr<grid_astar> workerPlanner;
+    std::thread worker;
+    // grid version last handed to the worker, under lock
+    u32 postedVersion = 0;
+
+    std::vector<f32> latencies;
+    int latencyNext = 0;
+    int completedCount = 0;
+    int overrunCount = 0;
+    f32 lastSliceUs = 0.f;
+    // moving average of one search in microseconds
+    f32 searchUs = 0.f;
+};
@@ -0,0 +1,46 @@
+#include "spatial_hash.h"
+
+void spatial_hash::rebuild(const f32* xs, const f32* ys, int count, f32 cellSize) {
+    this->cellSize = cellSize;
+    this->invCellSize = 1.f / cellSize;
+
+    // power of two table with at least twice as many buckets as entries keeps chains short
+    u32 bucketCount = 16;
+    while (bucketCount < (u32)count * 2) {
+        bucketCount <<= 1;
+    }
+    bucketMask = bucketCount - 1;
+
+    bucketStart.assign(bucketCount + 1, 0);
+    entries.resize(count);
+    entryBuckets.resize(count);
+
+    // count entries per bucket
+    for (int i = 0; i < count; ++i) {
+        u32 b = bucket(math::floor_int(xs[i] * invCellSize), math::floor_int(ys[i] * invCellSize));
+        entryBuckets[i] = b;
+        ++bucketStart[b];
+    }
+
+    // inclusive prefix sum leaves each bucket's end offset
+    for (u32 b = 1; b < bucketCount; ++b) {
+        bucketStart[b] += bucketStart[b - 1];
+    }
+    bucketStart[bucketCount] = count;
+
+    // scatter backwards, which walks every end offset back to its start and keeps index order within a bucket
+    for (int i = count - 1; i >= 0; --i) {
+        entries[--bucketStart[entryBuckets[i]]] = i;
+    }
+}
+
+void spatial_hash::query(const f32* xs, const f32* ys, const vec2& p, f32 radius, std::vector<int>& out) const {
+    const f32 radius2 = radius * radius;
+    for_each_nearby(p, [xs, ys, &p, radius2, &out](int i) {
+        f32 dx = xs[i] - p.x;
+        f32 dy = ys[i] - p.y;
+        if (dx * dx + dy * dy < radius2) {
+            out.push_back(i);
+        }
+    });
+}
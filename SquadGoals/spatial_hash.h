@@ -0,0 +1,75 @@
+#pragma once
+
+#include "algebra.h"
+#include <vector>
+
+// uniform grid bucketed by hashed cell coordinates, rebuilt from scratch with a counting sort
+// cell size should be at least the query radius so a 3x3 block of cells covers any neighbor
+
+class spatial_hash {
+public:
+    void rebuild(const f32* xs, const f32* ys, int count, f32 cellSize);
+
+    // calls visit(index) for every entry in the 3x3 cells around p, callers do their own distance test
+    template <typename F>
+    void for_each_nearby(const vec2& p, F&& visit) const;
+
+    // collects every entry within radius of p, radius must not exceed cell size
+    void query(const f32* xs, const f32* ys, const vec2& p, f32 radius, std::vector<int>& out) const;
+
+    inline f32 cell_size() const { return cellSize; }
+    inline int count() const { return (int)entries.size(); }
+    inline int bucket_count() const { return (int)bucketMask + 1; }
+
+private:
+    inline u32 bucket(int cx, int cy) const;
+
+    f32 cellSize = 1.f;
+    f32 invCellSize = 1.f;
+    u32 bucketMask = 0;
+
+    // bucketStart[b]..bucketStart[b + 1] is the range in entries for bucket b
+    std::vector<int> bucketStart;
+    std::vector<int> entries;
+    std::vector<u32> entryBuckets;
+};
+
+inline u32 spatial_hash::bucket(int cx, int cy) const {
+    return (((u32)cx * 73856093u) ^ ((u32)cy * 19349663u)) & bucketMask;
+}
+
+template <typename F>
+void spatial_hash::for_each_nearby(const vec2& p, F&& visit) const {
+    if (entries.empty()) {
+        return;
+    }
+
+    int cx = math::floor_int(p.x * invCellSize);
+    int cy = math::floor_int(p.y * invCellSize);
+
+    // distinct cells can hash to the same bucket, only walk each bucket once
+    u32 visited[9];
+    int visitedCount = 0;
+
+    for (int y = cy - 1; y <= cy + 1; ++y) {
+        for (int x = cx - 1; x <= cx + 1; ++x) {
+            u32 b = bucket(x, y);
+
+            bool seen = false;
+            for (int i = 0; i < visitedCount; ++i) {
+                if (visited[i] == b) {
+                    seen = true;
+                    break;
+                }
+            }
+            if (seen) {
+                continue;
+            }
+            visited[visitedCount++] = b;
+
+            for (int i = bucketStart[b]; i < bucketStart[b + 1]; ++i) {
+                visit(entries[i]);
+            }
+        }
+    }
+}
@@ -0,0 +1,836 @@
+#include "steer_sim.h"
+#include "flowfield.h"
+
+#include <Box2D/Box2D.h>
+
+#include "counter_rng.h"
+#include "path_builder.h"
+
+const char* seek_mode_strs[(int)agent_seek_mode::kCount] {
+    "wander",
+    "follow path",
+    "return",
+    "route",
+    "goal field"
+};
+
+const char* integrator_mode_strs[(int)integrator_mode::kCount] {
+    "box2d",
+    "euler",
+    "verlet"
+};
+
+static const i32 VELOCITY_ITERATIONS = 8;
+static const i32 POSITION_ITERATIONS = 8;
+
+// same per step cap as b2_maxTranslation so kinematic agents cant tunnel any more than bodies do
+static const f32 MAX_TRANSLATION = 2.f;
+
+// spawn draws use a tick value the sim never reaches so they cant collide with wander streams
+static const u64 SPAWN_STREAM_TICK = ~0ull;
+
+steer_sim::steer_sim()
+    : perlinGen(10000)
+{
+}
+
+steer_sim::~steer_sim() {
+}
+
+void steer_sim::init(const agent_config& config, const world_data& world) {
+    agentConfig = config;
+    worldData = world;
+    ticks = 0;
+    spawnedTotal = 0;
+    accumulator = 0.f;
+    droppedTicks = 0;
+    integrator = worldData.integrator;
+
+    if (!jobs || (worldData.threadCount > 0 && jobs->thread_count() != worldData.threadCount)) {
+        jobs = std::make_unique<job_system>(worldData.threadCount);
+    }
+
+    std::vector<vec2> pathPts;
+    const int ptCount = 20;
+    const f32 delta = 360.f / ptCount;
+    const f32 radX = 12, radY = 9;
+    for (int i = 0; i < ptCount; ++i) {
+        f32 a = delta * i;
+        f32 b = delta * (i + 1);
+        pathPts.push_back(vec2(math::cos(a) * radX, math::sin(a) * radY));
+        pathPts.push_back(vec2(math::cos(b) * radX, math::sin(b) * radY));
+    }
+
+    // the loop above emits every shared vertex twice, the builder welds them back together
+    path_builder builder;
+    if (worldData.smoothPath) {
+        // every fifth vertex is plenty of control for a spline
+        std::vector<vec2> ctrl;
+        for (size_t i = 0; i < pathPts.size(); i += 10) {
+            ctrl.push_back(pathPts[i]);
+        }
+        builder.add_catmull_rom(ctrl.data(), ctrl.size(), math::max(worldData.pathSplineTolerance, 0.001f));
+    }
+    else {
+        builder.add(pathPts.data(), pathPts.size());
+    }
+    builder.simplify_tolerance(worldData.pathSimplifyTolerance);
+    agentPath = std::make_unique<path>(builder.build(path_dir::kCW));
+    pathVerticesRemoved = builder.removed_count();
+
+    // the planners hold a reference to the grid, so they go first
+    const f32 navSize = 2.f * worldData.navExtent;
+    routeService.reset();
+    goalField.reset();
+    focusPlanner.reset();
+    chunkPlanner.reset();
+    navGrid = nav_grid(grid_layout(navSize, navSize, worldData.navCellSize, -worldData.navExtent, -worldData.navExtent));
+    routeService = std::make_unique<route_service>(navGrid, worldData.routeCacheSize);
+    goalField = std::make_unique<goal_field>(navGrid);
+    focusPlanner = std::make_unique<dstar_lite>(navGrid);
+    chunkPlanner = std::make_unique<hpa_planner>(navGrid, worldData.navChunkSize, worldData.routeCacheSize);
+
+    // agents must go before the world that owns their bodies
+    agentStore.clear();
+    neighbors = neighbor_list();
+    physicsWorld = std::make_unique<b2World>(vec2::ZERO);
+
+    spawn(worldData.agentCount);
+}
+
+int steer_sim::spawn(int count) {
+    const int first = agentStore.size();
+    if (count > MAX_AGENTS - first) {
+        count = MAX_AGENTS - first;
+    }
+    if (count <= 0) {
+        return 0;
+    }
+
+    agentStore.reserve(first + count);
+    neighbors.invalidate();
+
+    // keep roughly the original density as the crowd grows, the default 10 agents use the original area
+    const f32 spread = math::sqrt(math::max(1.f, (f32)(first + count) / 100.f));
+    const int extentX = (int)(20.f * spread);
+    const int extentY = (int)(11.f * spread);
+
+    for (int i = 0; i < count; ++i) {
+        // separate statements keep the draw order fixed, argument evaluation order isnt
+        counter_rng rng(worldData.seed, spawnedTotal++, SPAWN_STREAM_TICK);
+        vec2 position, target;
+        position.x = (f32)rng.range_int(-extentX, extentX);
+        position.y = (f32)rng.range_int(-extentY, extentY);
+        target.x = (f32)rng.range_int(-extentX, extentX);
+        target.y = (f32)rng.range_int(-extentY, extentY);
+        f32 wanderAngle = rng.range(0.f, 360.f);
+        b2Body* body = (integrator == integrator_mode::kBox2D) ? create_body(position) : nullptr;
+        agentStore.add(position, target, wanderAngle, body);
+    }
+
+    return count;
+}
+
+void steer_sim::despawn(agent_handle handle) {
+    int index = agentStore.index_of(handle);
+    if (index < 0) {
+        return;
+    }
+
+    if (agentStore.bodies[index] != nullptr) {
+        physicsWorld->DestroyBody(agentStore.bodies[index]);
+    }
+    agentStore.remove(handle);
+    neighbors.invalidate();
+}
+
+int steer_sim::despawn(int count) {
+    if (count > agentStore.size()) {
+        count = agentStore.size();
+    }
+
+    // removing from the back never swaps, so the rest of the columns stay untouched
+    for (int i = 0; i < count; ++i) {
+        int last = agentStore.size() - 1;
+        if (agentStore.bodies[last] != nullptr) {
+            physicsWorld->DestroyBody(agentStore.bodies[last]);
+        }
+        agentStore.remove(agentStore.handle_at(last));
+    }
+    neighbors.invalidate();
+
+    return count;
+}
+
+void steer_sim::set_agent_count(int count) {
+    const int current = agentStore.size();
+    if (count > current) {
+        spawn(count - current);
+    }
+    else if (count < current) {
+        despawn(current - count);
+    }
+    worldData.agentCount = agentStore.size();
+}
+
+b2Body* steer_sim::create_body(const vec2& position) {
+    b2BodyDef bodyDef;
+    bodyDef.type = b2_dynamicBody;
+    bodyDef.position = position;
+    b2Body* body = physicsWorld->CreateBody(&bodyDef);
+
+    b2CircleShape shapeDef;
+    shapeDef.m_radius = 0.25f;
+
+    b2FixtureDef fixtureDef;
+    fixtureDef.shape = &shapeDef;
+    fixtureDef.density = 1.0f;
+    fixtureDef.friction = 0.3f;
+
+    body->CreateFixture(&fixtureDef);
+
+    return body;
+}
+
+void steer_sim::tick(f32 dt) {
+    const agent_config& agentConfig = this->agentConfig;
+    agent_store& agents = this->agentStore;
+    const int count = agents.size();
+
+    // SYNC
+    // the only pass that reads bodies, everything after streams the columns
+    const bool kinematic = (integrator != integrator_mode::kBox2D);
+    for (int i = 0; i < count; ++i) {
+        agents.prevX[i] = agents.posX[i];
+        agents.prevY[i] = agents.posY[i];
+        agents.prevRotation[i] = agents.rotation[i];
+
+        if (kinematic) {
+            continue;
+        }
+
+        const b2Body* body = agents.bodies[i];
+        const b2Vec2& p = body->GetPosition();
+        const b2Vec2& v = body->GetLinearVelocity();
+        agents.posX[i] = p.x;
+        agents.posY[i] = p.y;
+        agents.velX[i] = v.x;
+        agents.velY[i] = v.y;
+    }
+
+    // the widest neighborhood radius bounds the lists, clamped so a zeroed ui field cant divide by zero
+    const f32 neighborDist = math::max(math::max(agentConfig.separationDist, agentConfig.flockDist), 0.1f);
+    const f32 skin = math::max(worldData.neighborSkin, 0.f);
+    if (neighbors.needs_rebuild(agents.posX.data(), agents.posY.data(), count, neighborDist, skin)) {
+        neighbors.rebuild(agents.posX.data(), agents.posY.data(), count, neighborDist, skin, *jobs);
+    }
+
+    schedule_lod();
+
+    if (agentConfig.seekMode == agent_seek_mode::kFollowPath) {
+        seed_path_cursors();
+    }
+    else if (agentConfig.seekMode == agent_seek_mode::kRoute) {
+        plan_routes();
+    }
+    else if (agentConfig.seekMode == agent_seek_mode::kGoalField && hasGoal) {
+        // a no-op unless the goal changed cell or the grid changed
+        goalField->update(goalPoint);
+    }
+
+    // STEER
+    // every agent only writes its own columns and draws from its own rng stream, so chunks can
+    // run in any order on any core and still match a serial run bit for bit
+    if (agentConfig.flowScalar != 0.f) {
+        const int steerCount = (int)steerList.size();
+        flowX.resize(steerCount);
+        flowY.resize(steerCount);
+        flowDir.resize(steerCount);
+    }
+    jobs->parallel_for(0, (int)steerList.size(), 256, [this, dt](int begin, int end) {
+        steer_range(begin, end, dt);
+    });
+    jobs->parallel_for(0, (int)coastList.size(), 1024, [this](int begin, int end) {
+        coast_range(begin, end);
+    });
+
+    // APPLY
+    if (kinematic) {
+        integrate(dt);
+    }
+    else {
+        for (int i = 0; i < count; ++i) {
+            agents.bodies[i]->ApplyForce(b2Vec2(agents.forceX[i], agents.forceY[i]), vec2::ZERO, true);
+        }
+
+        physicsWorld->Step(dt, VELOCITY_ITERATIONS, POSITION_ITERATIONS);
+    }
+    ++ticks;
+}
+
+void steer_sim::integrate(f32 dt) {
+    agent_store& agents = this->agentStore;
+    const int count = agents.size();
+    const f32 radius = math::max(worldData.agentRadius, 0.01f);
+    // unit density circle, the same mass box2d gives the body fixture
+    const f32 invMass = 1.f / (math::PI * radius * radius);
+    const bool verlet = (integrator == integrator_mode::kVerlet);
+
+    jobs->parallel_for(0, count, 1024, [&agents, dt, invMass, verlet](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            f32 ax = agents.forceX[i] * invMass;
+            f32 ay = agents.forceY[i] * invMass;
+
+            // verlet takes its implied velocity from last tick's displacement, euler integrates it explicitly
+            f32 dx, dy;
+            if (verlet) {
+                dx = agents.velX[i] * dt + ax * dt * dt;
+                dy = agents.velY[i] * dt + ay * dt * dt;
+            }
+            else {
+                agents.velX[i] += ax * dt;
+                agents.velY[i] += ay * dt;
+                dx = agents.velX[i] * dt;
+                dy = agents.velY[i] * dt;
+            }
+
+            f32 len2 = dx * dx + dy * dy;
+            if (len2 > MAX_TRANSLATION * MAX_TRANSLATION) {
+                f32 scale = MAX_TRANSLATION / math::sqrt(len2);
+                dx *= scale;
+                dy *= scale;
+                if (!verlet) {
+                    agents.velX[i] *= scale;
+                    agents.velY[i] *= scale;
+                }
+            }
+
+            agents.posX[i] += dx;
+            agents.posY[i] += dy;
+        }
+    });
+
+    resolve_overlaps(radius);
+
+    // SYNC already copied the start of tick position into prev, so the corrected displacement is the velocity
+    if (verlet) {
+        const f32 invDt = 1.f / dt;
+        for (int i = 0; i < count; ++i) {
+            agents.velX[i] = (agents.posX[i] - agents.prevX[i]) * invDt;
+            agents.velY[i] = (agents.posY[i] - agents.prevY[i]) * invDt;
+        }
+    }
+}
+
+void steer_sim::resolve_overlaps(f32 radius) {
+    agent_store& agents = this->agentStore;
+    const int count = agents.size();
+    const f32 minDist = radius * 2.f;
+
+    // built once per tick, corrections are a fraction of the cell size so stale cells only miss grazing contacts
+    contacts.rebuild(agents.posX.data(), agents.posY.data(), count, minDist);
+    pushX.resize(count);
+    pushY.resize(count);
+
+    for (int iteration = 0; iteration < worldData.overlapIterations; ++iteration) {
+        // jacobi style, gather every push from a frozen snapshot then apply them all, so the
+        // result doesnt depend on how the agents are split across threads
+        jobs->parallel_for(0, count, 512, [this, &agents, minDist](int begin, int end) {
+            const f32* posX = agents.posX.data();
+            const f32* posY = agents.posY.data();
+
+            for (int i = begin; i < end; ++i) {
+                const vec2 position(posX[i], posY[i]);
+                vec2 push = vec2::ZERO;
+
+                contacts.for_each_nearby(position, [posX, posY, minDist, i, &position, &push](int j) {
+                    if (j == i) {
+                        return;
+                    }
+
+                    f32 dx = position.x - posX[j];
+                    f32 dy = position.y - posY[j];
+                    f32 d2 = dx * dx + dy * dy;
+                    if (d2 >= minDist * minDist) {
+                        return;
+                    }
+
+                    // each side of the pair moves half the overlap
+                    if (d2 > 0.f) {
+                        f32 d = math::sqrt(d2);
+                        f32 s = 0.5f * (minDist - d) / d;
+                        push.x += dx * s;
+                        push.y += dy * s;
+                    }
+                    else {
+                        // exactly stacked, split them along x by index so the pair still separates
+                        push.x += (i < j) ? -0.5f * minDist : 0.5f * minDist;
+                    }
+                });
+
+                pushX[i] = push.x;
+                pushY[i] = push.y;
+            }
+        });
+
+        jobs->parallel_for(0, count, 1024, [this, &agents](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                agents.posX[i] += pushX[i];
+                agents.posY[i] += pushY[i];
+            }
+        });
+    }
+}
+
+void steer_sim::seed_path_cursors() {
+    const path& agentPath = *this->agentPath;
+    agent_store& agents = this->agentStore;
+
+    // long paths are better served by each agent searching the bvh on its own
+    if (agentPath.has_bvh()) {
+        return;
+    }
+
+    seedList.clear();
+    for (int i : steerList) {
+        if (agents.pathCursor[i].segment < 0) {
+            seedList.push_back(i);
+        }
+    }
+    if (seedList.empty()) {
+        return;
+    }
+
+    // new agents have no cursor, find them all in one batched scan instead of one full scan each
+    const int seedCount = (int)seedList.size();
+    seedX.resize(seedCount);
+    seedY.resize(seedCount);
+    seedSegment.resize(seedCount);
+    for (int k = 0; k < seedCount; ++k) {
+        seedX[k] = agents.posX[seedList[k]];
+        seedY[k] = agents.posY[seedList[k]];
+    }
+
+    path_batch_query query;
+    query.xs = seedX.data();
+    query.ys = seedY.data();
+    query.count = seedCount;
+    query.segment = seedSegment.data();
+
+    jobs->parallel_for(0, seedCount, 256, [&agentPath, &query](int begin, int end) {
+        agentPath.nearest_batch(query, begin, end);
+    });
+
+    for (int k = 0; k < seedCount; ++k) {
+        agents.pathCursor[seedList[k]].segment = seedSegment[k];
+    }
+}
+
+void steer_sim::plan_routes() {
+    agent_store& agents = this->agentStore;
+    if (!hasGoal) {
+        return;
+    }
+
+    // the planners arent thread safe, but agents mostly share start cells with a neighbour who already
+    // asked, so after the first tick nearly every lookup is a cache hit
+    const agent_config& agentConfig = this->agentConfig;
+    const bool hierarchical = worldData.hierarchicalRoutes;
+    for (int i : steerList) {
+        const bool focused = (agents.handle_at(i) == focusAgent);
+        const bool stale = (agents.routeEpoch[i] != routeEpoch);
+
+        if (hierarchical && !focused) {
+            hpa_plan* plan = agents.routePlan[i].get();
+            if (stale) {
+                agents.routePlan[i] = chunkPlanner->find(agents.position(i), goalPoint);
+                agents.routeLeg[i] = 0;
+                agents.routeTicket[i] = INVALID_TICKET;
+                agents.routeEpoch[i] = routeEpoch;
+                plan = agents.routePlan[i].get();
+                agents.route[i] = (plan != nullptr) ? chunkPlanner->leg(*plan, 0) : nullptr;
+                agents.pathCursor[i].segment = -1;
+            }
+            else if (plan != nullptr && agents.route[i] != nullptr && agents.routeLeg[i] + 1 < plan->leg_count()
+                && agents.pathProgress[i] + agentConfig.pathLookahead >= agents.route[i]->length()) {
+                // the lookahead is about to run off this leg, refine the next one
+                agents.route[i] = chunkPlanner->leg(*plan, ++agents.routeLeg[i]);
+                agents.pathCursor[i].segment = -1;
+                // the grid changed under the plan, search again next tick
+                if (agents.route[i] == nullptr) {
+                    agents.routePlan[i] = nullptr;
+                    agents.routeEpoch[i] = 0;
+                }
+            }
+            continue;
+        }
+
+        // a leg left over from hierarchical planning doesnt reach the goal, so it has to go too
+        if (!stale && agents.routePlan[i] == nullptr) {
+            continue;
+        }
+
+        if (focused) {
+            // d* lite repairs in place, so the focus agent never waits on the queue
+            agents.route[i] = focusPlanner->plan(agents.position(i), goalPoint);
+            agents.routePlan[i] = nullptr;
+            agents.routeTicket[i] = INVALID_TICKET;
+            agents.routeEpoch[i] = routeEpoch;
+            agents.pathCursor[i].segment = -1;
+        }
+        else if (agents.routeTicket[i] == INVALID_TICKET) {
+            agents.routeTicket[i] = routeService->submit(agents.handle_at(i), agents.position(i), goalPoint);
+        }
+    }
+
+    routeService->set_mode(worldData.routeServiceMode);
+    routeResults.clear();
+    routeService->update(worldData.routeBudgetUs, routeResults);
+
+    // agents can be despawned or have asked again since, only the ticket they hold counts
+    for (const route_result& result : routeResults) {
+        int i = agents.index_of(result.agent);
+        if (i < 0 || agents.routeTicket[i] != result.ticket) {
+            continue;
+        }
+        agents.route[i] = result.route;
+        agents.routePlan[i] = nullptr;
+        agents.routeTicket[i] = INVALID_TICKET;
+        agents.routeEpoch[i] = routeEpoch;
+        agents.pathCursor[i].segment = -1;
+    }
+}
+
+void steer_sim::drop_routes() {
+    // routes stay so agents have something to follow while the new ones are planned
+    agent_store& agents = this->agentStore;
+    ++routeEpoch;
+    routeService->cancel_all();
+    for (int i = 0; i < agents.size(); ++i) {
+        agents.routeTicket[i] = INVALID_TICKET;
+    }
+}
+
+void steer_sim::set_goal(const vec2& point) {
+    goalPoint = point;
+    hasGoal = true;
+    drop_routes();
+}
+
+void steer_sim::clear_goal() {
+    hasGoal = false;
+    drop_routes();
+}
+
+void steer_sim::set_nav_cost(int cx, int cy, u8 cost) {
+    u32 version = navGrid.version();
+    navGrid.set_cost(cx, cy, cost);
+    if (navGrid.version() != version) {
+        drop_routes();
+    }
+}
+
+void steer_sim::set_focus(const vec2& point, agent_handle important) {
+    focusPoint = point;
+    focusAgent = important;
+}
+
+static inline int lod_interval(const world_data& world, int level) {
+    int interval = (level == 0) ? 1 : (level == 1) ? world.lodMidInterval : world.lodFarInterval;
+    return (interval > 1) ? interval : 1;
+}
+
+void steer_sim::schedule_lod() {
+    const world_data& world = this->worldData;
+    agent_store& agents = this->agentStore;
+    const int count = agents.size();
+
+    steerList.clear();
+    coastList.clear();
+    lodCounts[0] = lodCounts[1] = lodCounts[2] = 0;
+
+    if (!world.lodEnabled) {
+        for (int i = 0; i < count; ++i) {
+            agents.lodLevel[i] = 0;
+            steerList.push_back(i);
+        }
+        lodCounts[0] = count;
+        return;
+    }
+
+    const f32 near2 = world.lodNearDist * world.lodNearDist;
+    const f32 far2 = world.lodFarDist * world.lodFarDist;
+
+    for (int i = 0; i < count; ++i) {
+        f32 dx = agents.posX[i] - focusPoint.x;
+        f32 dy = agents.posY[i] - focusPoint.y;
+        f32 d2 = dx * dx + dy * dy;
+
+        agent_handle handle = agents.handle_at(i);
+        int level = (handle == focusAgent || d2 < near2) ? 0 : (d2 < far2) ? 1 : 2;
+        agents.lodLevel[i] = (u8)level;
+        ++lodCounts[level];
+
+        // stagger on the handle so each bucket spreads its work evenly over its interval
+        u64 interval = (u64)lod_interval(world, level);
+        if ((handle + ticks) % interval == 0) {
+            steerList.push_back(i);
+        }
+        else {
+            coastList.push_back(i);
+        }
+    }
+}
+
+int steer_sim::advance(f32 frameDt) {
+    const f32 dt = fixed_dt();
+    accumulator += frameDt;
+
+    int ran = 0;
+    while (accumulator >= dt && ran < worldData.maxTicksPerFrame) {
+        tick(dt);
+        accumulator -= dt;
+        ++ran;
+    }
+
+    // after a long stall drop whatever the catch up budget couldnt cover instead of spiralling
+    if (accumulator >= dt) {
+        int behind = (int)(accumulator / dt);
+        droppedTicks += behind;
+        accumulator -= behind * dt;
+    }
+
+    return ran;
+}
+
+void steer_sim::coast_range(int begin, int end) {
+    const agent_config& agentConfig = this->agentConfig;
+    agent_store& agents = this->agentStore;
+
+    // the targets and neighbours behind desired are left alone until the next full steer, but the
+    // correction towards it follows the velocity as it changes, so agents settle instead of overshooting
+    for (int k = begin; k < end; ++k) {
+        const int i = coastList[k];
+        vec2 steer = vec2(agents.desiredX[i], agents.desiredY[i]) - agents.velocity(i);
+        steer.limit(agentConfig.maxAccel);
+        agents.forceX[i] = steer.x;
+        agents.forceY[i] = steer.y;
+    }
+}
+
+void steer_sim::steer_range(int begin, int end, f32 dt) {
+    const agent_config& agentConfig = this->agentConfig;
+    const world_data& world = this->worldData;
+    const perlin_gen& perlin = this->perlinGen;
+    const path& agentPath = *this->agentPath;
+    agent_store& agents = this->agentStore;
+
+    // the flow field noise for the whole chunk in one batched pass, the batch matches noise exactly.
+    // skipped when the flow carries no weight
+    const bool useFlow = (agentConfig.flowScalar != 0.f);
+    if (useFlow) {
+        for (int k = begin; k < end; ++k) {
+            const int i = steerList[k];
+            flowX[k] = agents.posX[i] / world.flowDivisor;
+            flowY[k] = agents.posY[i] / world.flowDivisor;
+        }
+        flow_field::perlin_get(perlin, flowX.data() + begin, flowY.data() + begin, world.flowDepth, flowDir.data() + begin, end - begin);
+    }
+
+    for (int k = begin; k < end; ++k) {
+        const int i = steerList[k];
+        const vec2 position = agents.position(i);
+        const vec2 velocity = agents.velocity(i);
+
+        // an agent steering every n ticks advances its timers by n ticks worth
+        const f32 agentDt = dt * (f32)lod_interval(world, agents.lodLevel[i]);
+
+        // TARGET
+        {
+            // keyed on the stable handle, not the dense index, so removes dont reshuffle streams
+            counter_rng rng(world.seed, agents.handle_at(i), ticks);
+
+            auto wander = [&agents, &agentConfig, &rng, agentDt, i, &position, &velocity]() -> void {
+                vec2 heading = velocity;
+                if (velocity == vec2::ZERO) {
+                    heading = math::vec2_from_angle(rng.range(0.f, 360.f));
+                }
+
+                vec2 future = position + vec2::normalize(heading) * agentConfig.wanderProjectionDist;
+                agents.futureX[i] = future.x;
+                agents.futureY[i] = future.y;
+
+                f32& wanderAngle = agents.wanderAngle[i];
+                f32& wanderTimer = agents.wanderTimer[i];
+                wanderTimer -= agentDt;
+                if (wanderTimer <= 0) {
+                    wanderAngle += rng.range(-agentConfig.wanderAngleRange, agentConfig.wanderAngleRange);
+                    wanderTimer += agentConfig.wanderInterval;
+                }
+
+                agents.targetX[i] = future.x + math::cos(wanderAngle) * agentConfig.wanderProjectionRadius;
+                agents.targetY[i] = future.y + math::sin(wanderAngle) * agentConfig.wanderProjectionRadius;
+            };
+
+            switch (agentConfig.seekMode) {
+            case agent_seek_mode::kWander:
+                wander();
+                break;
+            case agent_seek_mode::kFollowPath: {
+                // progress along the path, then the target is just further along by arc length
+                path_cursor& cursor = agents.pathCursor[i];
+                vec2 onPath;
+                f32 progress = agentPath.project(position, cursor, agentConfig.pathRefindDist, &onPath);
+                agents.pathProgress[i] = progress;
+
+                vec2 target = agentPath.point_at(progress + agentConfig.pathLookahead, cursor.segment);
+                agents.targetX[i] = target.x;
+                agents.targetY[i] = target.y;
+                agents.futureX[i] = onPath.x;
+                agents.futureY[i] = onPath.y;
+                break;
+            }
+            case agent_seek_mode::kReturn:
+                agents.targetX[i] = 0.f;
+                agents.targetY[i] = 0.f;
+                break;
+            case agent_seek_mode::kRoute: {
+                // same as following the path, except the route ends, and once the lookahead runs
+                // off the end the goal itself is the target
+                const path* route = agents.route[i].get();
+                if (!hasGoal || (route == nullptr && agents.routeTicket[i] != INVALID_TICKET)) {
+                    // nothing to follow until the first route lands
+                    wander();
+                }
+                else if (route == nullptr || route->segment_count() == 0) {
+                    // off the grid, unreachable or already in the goal cell, head straight for it
+                    agents.targetX[i] = goalPoint.x;
+                    agents.targetY[i] = goalPoint.y;
+                }
+                else {
+                    path_cursor& cursor = agents.pathCursor[i];
+                    vec2 onRoute;
+                    f32 progress = route->project(position, cursor, agentConfig.pathRefindDist, &onRoute);
+                    agents.pathProgress[i] = progress;
+
+                    // a hierarchical leg that isnt the last ends at a waypoint, not at the goal
+                    const hpa_plan* plan = agents.routePlan[i].get();
+                    const bool lastLeg = (plan == nullptr || agents.routeLeg[i] + 1 >= plan->leg_count());
+                    f32 ahead = progress + agentConfig.pathLookahead;
+                    vec2 target = (ahead < route->length()) ? route->point_at(ahead, cursor.segment)
+                        : lastLeg ? goalPoint : route->point_at(ahead);
+                    agents.targetX[i] = target.x;
+                    agents.targetY[i] = target.y;
+                    agents.futureX[i] = onRoute.x;
+                    agents.futureY[i] = onRoute.y;
+                }
+                break;
+            }
+            case agent_seek_mode::kGoalField: {
+                vec2 dir = hasGoal ? goalField->direction(position) : vec2::ZERO;
+                if (!hasGoal) {
+                    wander();
+                }
+                else if (dir == vec2::ZERO) {
+                    // off the grid, cut off or already in the goal cell
+                    agents.targetX[i] = goalPoint.x;
+                    agents.targetY[i] = goalPoint.y;
+                }
+                else {
+                    vec2 target = position + dir * agentConfig.pathLookahead;
+                    agents.targetX[i] = target.x;
+                    agents.targetY[i] = target.y;
+                }
+                break;
+            }
+            case agent_seek_mode::kCount:
+                break;
+            }
+        }
+
+        // FLOCK
+        // separation, alignment and cohesion share one walk over the neighborhood
+        vec2 separation = vec2::ZERO;
+        vec2 alignment = vec2::ZERO;
+        vec2 cohesion = vec2::ZERO;
+        {
+            const f32* posX = agents.posX.data();
+            const f32* posY = agents.posY.data();
+            const f32* velX = agents.velX.data();
+            const f32* velY = agents.velY.data();
+            const f32 sepDist2 = agentConfig.separationDist * agentConfig.separationDist;
+            const f32 flockDist2 = agentConfig.flockDist * agentConfig.flockDist;
+
+            vec2 sepSum = vec2::ZERO;
+            vec2 velSum = vec2::ZERO;
+            vec2 posSum = vec2::ZERO;
+            int sepCount = 0;
+            int flockCount = 0;
+
+            neighbors.for_each(i, [posX, posY, velX, velY, sepDist2, flockDist2, &position,
+                &sepSum, &velSum, &posSum, &sepCount, &flockCount](int j) {
+                vec2 delta(position.x - posX[j], position.y - posY[j]);
+                f32 d2 = delta.x * delta.x + delta.y * delta.y;
+
+                if (d2 > 0 && d2 < sepDist2) {
+                    // normalize(delta) / d without a second sqrt
+                    sepSum += delta / d2;
+                    ++sepCount;
+                }
+
+                if (d2 < flockDist2) {
+                    velSum.x += velX[j];
+                    velSum.y += velY[j];
+                    posSum.x += posX[j];
+                    posSum.y += posY[j];
+                    ++flockCount;
+                }
+            });
+
+            if (sepCount > 0) {
+                separation = vec2::normalize(sepSum / (f32)sepCount) * agentConfig.maxSpeed;
+            }
+
+            if (flockCount > 0) {
+                alignment = velSum / (f32)flockCount;
+                if (alignment != vec2::ZERO) {
+                    alignment = vec2::normalize(alignment) * agentConfig.maxSpeed;
+                }
+
+                cohesion = posSum / (f32)flockCount - position;
+                if (cohesion != vec2::ZERO) {
+                    cohesion = vec2::normalize(cohesion) * agentConfig.maxSpeed;
+                }
+            }
+        }
+
+        // SEEK
+        [this, &agents, &separation, &alignment, &cohesion, &agentConfig, useFlow, i, k, &position, &velocity] {
+            vec2 targetDir;
+            f32 targetDist;
+
+            vec2 targetDelta = agents.target(i) - position;
+
+            targetDelta.decompose(targetDir, targetDist);
+
+            const vec2 flow = useFlow ? flowDir[k] : vec2::ZERO;
+            vec2 movement = targetDir * math::clamp01(targetDist / 40);
+
+            vec2 desired = agentConfig.movementScalar * movement + agentConfig.flowScalar * flow + agentConfig.separationScalar * separation
+                + agentConfig.alignmentScalar * alignment + agentConfig.cohesionScalar * cohesion;
+            desired.normalize();
+            desired *= agentConfig.maxSpeed;
+
+            vec2 steer = desired - velocity;
+            steer.limit(agentConfig.maxAccel);
+
+            agents.forceX[i] = steer.x;
+            agents.forceY[i] = steer.y;
+            agents.desiredX[i] = desired.x;
+            agents.desiredY[i] = desired.y;
+        }();
+
+        // TICK MOVEMENT
+        agents.rotation[i] = math::angle_from_vec2(vec2::normalize(velocity));
+    }
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "algebra.h"
+#include "perlin.h"
+#include "path.h"
+#include "spatial_hash.h"
+#include "neighbor_list.h"
+#include "agent_store.h"
+#include "job_system.h"
+#include "nav_grid.h"
+#include "grid_astar.h"
+#include "goal_field.h"
+#include "dstar_lite.h"
+#include "hpa_planner.h"
+#include "route_service.h"
+
+#include <vector>
+#include <memory>
+
+// headless steering simulation, owns the agents and the physics world and knows nothing about
+// SDL, GL or ImGui so it can be stepped from the app loop or from a profiling harness alike
+
+class b2World;
+
+enum class agent_seek_mode {
+    kWander,
+    kFollowPath,
+    kReturn,
+    // plan a route across the nav grid to the goal and follow it like the path
+    kRoute,
+    // head down the shared goal field, one solve for the whole crowd
+    kGoalField,
+    kCount,
+};
+
+extern const char* seek_mode_strs[(int)agent_seek_mode::kCount];
+
+// kBox2D runs every agent as a rigid body, the others skip box2d and move the columns directly,
+// pushing overlapping circles apart through the spatial hash
+enum class integrator_mode {
+    kBox2D,
+    kEuler,
+    kVerlet,
+    kCount,
+};
+
+extern const char* integrator_mode_strs[(int)integrator_mode::kCount];
+
+struct agent_config {
+    agent_seek_mode seekMode = agent_seek_mode::kFollowPath;
+
+    f32 maxSpeed = 10.f;
+    f32 maxAccel = 5.f;
+
+    f32 wanderProjectionDist = 4.f;
+    f32 wanderProjectionRadius = 1.f;
+
+    f32 wanderAngleRange = 4.f;
+    f32 wanderInterval = 1 / 30.f;
+
+    f32 separationDist = 2.f;
+    // alignment and cohesion look this far
+    f32 flockDist = 2.f;
+
+    f32 movementScalar = 1.f;
+    f32 flowScalar = 0.f;
+    f32 separationScalar = 0.1f;
+    f32 alignmentScalar = 0.f;
+    f32 cohesionScalar = 0.f;
+
+    // how far along the path past an agent's own progress it steers towards
+    f32 pathLookahead = 3.f;
+    // path cursors rescan the whole path once their local search is this far off
+    f32 pathRefindDist = 4.f;
+};
+
+struct world_data {
+    f32 flowDivisor = 32.f;
+    f32 flowDepth = 0.f;
+
+    int agentCount = 10;
+    // douglas-peucker tolerance applied to the agent path on init, 0 only welds and drops collinear points
+    f32 pathSimplifyTolerance = 0.f;
+    // run the path as a catmull-rom loop through a few of its points, flattened to within pathSplineTolerance
+    bool smoothPath = false;
+    f32 pathSplineTolerance = 0.02f;
+    u32 seed = 1;
+
+    // threads used for the steering pass including the caller, 0 uses every hardware thread
+    int threadCount = 0;
+
+    // fixed simulation rate, frames run as many ticks as their time covers up to maxTicksPerFrame
+    int tickRate = 60;
+    int maxTicksPerFrame = 8;
+
+    // steering level of detail, agents past lodNearDist from the focus only re-steer every
+    // lodMidInterval ticks and past lodFarDist every lodFarInterval. in between their force is
+    // extrapolated, re-aimed from the current velocity at the velocity the last steer wanted
+    bool lodEnabled = true;
+    f32 lodNearDist = 40.f;
+    f32 lodFarDist = 80.f;
+    int lodMidInterval = 2;
+    int lodFarInterval = 4;
+
+    // neighbor lists reach this far past the flocking radius and are only rebuilt once some agent
+    // has moved half of it, 0 rebuilds every tick
+    f32 neighborSkin = 1.f;
+
+    // picked up by init, the population cant change integrator mid run
+    integrator_mode integrator = integrator_mode::kBox2D;
+    // collision radius, matches the box2d circle
+    f32 agentRadius = 0.25f;
+    // jacobi relaxation passes per tick for the kinematic integrators
+    int overlapIterations = 2;
+
+    // the nav grid covers [-navExtent, navExtent] on both axes, rebuilt by init
+    f32 navExtent = 64.f;
+    f32 navCellSize = 1.f;
+    // routes remembered by (start cell, goal cell)
+    int routeCacheSize = 256;
+    // plan routes over chunks of navChunkSize cells and refine them a chunk at a time, for big grids
+    bool hierarchicalRoutes = false;
+    int navChunkSize = 16;
+    // flat routes are planned through a request queue, either in slices of at most routeBudgetUs
+    // per tick or on a worker thread, agents keep their last route until the new one lands
+    route_service_mode routeServiceMode = route_service_mode::kSliced;
+    f32 routeBudgetUs = 500.f;
+};
+
+const int LOD_LEVEL_COUNT = 3;
+
+class steer_sim {
+public:
+    steer_sim();
+    ~steer_sim();
+
+    // (re)creates the physics world, path and agent population
+    void init(const agent_config& config, const world_data& world);
+    // advance the simulation by dt seconds
+    void tick(f32 dt);
+    // accumulate frame time and run whole fixed ticks, returns how many ran
+    int advance(f32 frameDt);
+    // adds count agents with paired bodies, returns how many fit under MAX_AGENTS
+    int spawn(int count);
+    // destroys the agent and its body, stale handles are ignored
+    void despawn(agent_handle handle);
+    // despawns the count most recently stored agents, returns how many went
+    int despawn(int count);
+    // spawns or despawns to reach count without touching the rest of the world
+    void set_agent_count(int count);
+    // lod distances are measured from point, the important agent always steers at full rate
+    void set_focus(const vec2& point, agent_handle important = INVALID_AGENT);
+    // where route mode heads, every agent replans on the next tick it steers
+    void set_goal(const vec2& point);
+    void clear_goal();
+    // changes a nav grid cell's cost, routes planned across the old grid are replanned
+    void set_nav_cost(int cx, int cy, u8 cost);
+
+    // tunables, safe to modify between ticks
+    inline agent_config& config() { return agentConfig; }
+    inline world_data& world() { return worldData; }
+
+    inline const agent_config& config() const { return agentConfig; }
+    inline const world_data& world() const { return worldData; }
+    inline const agent_store& agents() const { return agentStore; }
+    inline const path& agent_path() const { return *agentPath; }
+    inline const perlin_gen& perlin() const { return perlinGen; }
+    inline const neighbor_list& neighbor_lists() const { return neighbors; }
+    inline const nav_grid& nav() const { return navGrid; }
+    // the sliced planner, the worker's runs on its own thread and grid
+    inline const grid_astar& route_planner() const { return routeService->sliced_planner(); }
+    inline const route_service& route_queue() const { return *routeService; }
+    // bumped whenever the goal or grid changes, agents whose routeEpoch matches hold a current route
+    inline u32 route_epoch() const { return routeEpoch; }
+    inline const goal_field& goal_flow() const { return *goalField; }
+    inline const dstar_lite& focus_planner() const { return *focusPlanner; }
+    inline const hpa_planner& chunk_planner() const { return *chunkPlanner; }
+    inline bool has_goal() const { return hasGoal; }
+    inline const vec2& goal() const { return goalPoint; }
+    inline int thread_count() const { return jobs->thread_count(); }
+    inline u64 tick_count() const { return ticks; }
+    inline f32 fixed_dt() const { return 1.f / (f32)((worldData.tickRate > 0) ? worldData.tickRate : 1); }
+    // how far the leftover frame time is into the next tick, for blending prev/current agent state
+    inline f32 interpolation_alpha() const { return accumulator / fixed_dt(); }
+    inline int dropped_ticks() const { return droppedTicks; }
+    inline int path_vertices_removed() const { return pathVerticesRemoved; }
+    inline int lod_count(int level) const { return lodCounts[level]; }
+    inline int steered_count() const { return (int)steerList.size(); }
+    inline integrator_mode active_integrator() const { return integrator; }
+
+private:
+    b2Body* create_body(const vec2& position);
+    void schedule_lod();
+    void seed_path_cursors();
+    void plan_routes();
+    void drop_routes();
+    void steer_range(int begin, int end, f32 dt);
+    void coast_range(int begin, int end);
+    void integrate(f32 dt);
+    void resolve_overlaps(f32 radius);
+
+    agent_config agentConfig;
+    world_data worldData;
+
+    std::unique_ptr<b2World> physicsWorld;
+    std::unique_ptr<path> agentPath;
+    perlin_gen perlinGen;
+
+    agent_store agentStore;
+    neighbor_list neighbors;
+    nav_grid navGrid;
+    std::unique_ptr<route_service> routeService;
+    // bumped whenever the goal or grid changes, routes planned under an older one get replanned
+    u32 routeEpoch = 1;
+    std::vector<route_result> routeResults;
+    std::unique_ptr<goal_field> goalField;
+    // the focus agent keeps its own incremental route so grid edits around it repair instead of replanning
+    std::unique_ptr<dstar_lite> focusPlanner;
+    std::unique_ptr<hpa_planner> chunkPlanner;
+    vec2 goalPoint = vec2::ZERO;
+    bool hasGoal = false;
+    std::unique_ptr<job_system> jobs;
+
+    integrator_mode integrator = integrator_mode::kBox2D;
+    spatial_hash contacts;
+    std::vector<f32> pushX, pushY;
+
+    vec2 focusPoint = vec2::ZERO;
+    agent_handle focusAgent = INVALID_AGENT;
+    // dense indices of the agents steering this tick, and of the ones extrapolating
+    std::vector<int> steerList;
+    std::vector<int> coastList;
+    int lodCounts[LOD_LEVEL_COUNT] = { 0, 0, 0 };
+    // agents without a path cursor yet and their batched lookups
+    std::vector<int> seedList;
+    std::vector<f32> seedX, seedY;
+    std::vector<int> seedSegment;
+    // per steering agent flow noise inputs and directions, filled a chunk at a time
+    std::vector<f32> flowX, flowY;
+    std::vector<vec2> flowDir;
+    u64 ticks = 0;
+    // spawn rng streams are keyed on this so a run spawns the same agents regardless of despawns
+    u64 spawnedTotal = 0;
+    f32 accumulator = 0.f;
+    int droppedTicks = 0;
+    int pathVerticesRemoved = 0;
+};